@@ -1,33 +1,275 @@
 ﻿#include "belt.h"
 
-// Rotates the conveyor belt by shifting all items one index
-// and wrapping the last item to the first index.
-void rotateBelt(RestaurantState* state) {
-    P(SEM_MUTEX_BELT);
-    
-    // Optimization: only rotate if belt is not empty
-    bool empty = true;
-    for (int i = 0; i < BELT_SIZE; ++i) {
-        if (state->belt[i].dishID != 0) {
-            empty = false;
-            break;
+#if BELT_LOCKFREE
+// Finds the first slot in [from, to) whose occupancy equals wantSet
+static int findSlot(const RestaurantState* state, int from, int to, bool wantSet) {
+    for (int i = from; i < to; ++i)
+        if (beltIsOccupied(state, i) == wantSet)
+            return i;
+    return -1;
+}
+
+// Publishes word into the first empty slot at or after start (wrapping).
+// The caller holds a unit of beltItemCount, so an empty slot exists.
+static int publishWord(RestaurantState* state, int start, uint64_t word) {
+    for (int i = start;; i = (i + 1) % BELT_SIZE) {
+        uint64_t empty = 0;
+        if (state->belt.slot[i].load(std::memory_order_relaxed) == 0 &&
+            state->belt.slot[i].compare_exchange_strong(empty, word, std::memory_order_release, std::memory_order_relaxed))
+            return i;
+    }
+}
+#else
+// Bits of word w that correspond to real slots (the last word may be partial)
+static inline uint64_t validMask(int w) {
+    int bits = BELT_SIZE - w * 64;
+    return bits >= 64 ? ~0ULL : ((1ULL << bits) - 1);
+}
+
+// Finds the first slot in [from, to) whose occupancy bit equals wantSet
+static int findSlot(const RestaurantState* state, int from, int to, bool wantSet) {
+    for (int w = from >> 6; w <= (to - 1) >> 6 && from < to; ++w) {
+        uint64_t bits = __atomic_load_n(&state->beltOccupied[w], __ATOMIC_RELAXED);
+        if (!wantSet) bits = ~bits;
+        bits &= validMask(w);
+        if (w == from >> 6) bits &= ~0ULL << (from & 63);
+        if (bits == 0) continue;
+
+        int idx = w * 64 + __builtin_ctzll(bits);
+        return idx < to ? idx : -1;
+    }
+    return -1;
+}
+#endif
+
+int beltFindFreeSlot(const RestaurantState* state, int fromLogical) {
+#if !BELT_LOCKFREE
+    if (beltItems(state) >= BELT_SIZE)
+        return -1;
+#endif
+
+    int start = beltPhysicalSlot(state, fromLogical);
+    int p = findSlot(state, start, BELT_SIZE, false);
+    if (p == -1)
+        p = findSlot(state, 0, start, false);
+
+    return p == -1 ? -1 : beltLogicalSlot(state, p);
+}
+
+// The belt advances logical positions by one per rotation, so upstream of a
+// window means lower logical positions
+int beltFindFreeNearWindow(const RestaurantState* state, int tableIndex) {
+#if !BELT_LOCKFREE
+    if (beltItems(state) >= BELT_SIZE)
+        return -1;
+#endif
+
+    int start = beltWindowStart(tableIndex);
+    for (int k = 0; k < BELT_WINDOW_SLOTS; ++k) {
+        int logical = (start + k) % BELT_SIZE;
+        if (!beltIsOccupied(state, beltPhysicalSlot(state, logical)))
+            return logical;
+    }
+    for (int k = 1; k <= BELT_SIZE - BELT_WINDOW_SLOTS; ++k) {
+        int logical = (start - k + BELT_SIZE) % BELT_SIZE;
+        if (!beltIsOccupied(state, beltPhysicalSlot(state, logical)))
+            return logical;
+    }
+    return -1;
+}
+
+#if BELT_LOCKFREE
+int beltPlaceDish(RestaurantState* state, Dish& plate, int fromLogical, int tableIndex) {
+    // Reserve a slot first (the lock-free counterpart of P(SEM_BELT_SLOTS))
+    int items = beltItems(state);
+    do {
+        while (items >= BELT_SIZE) {
+            if (terminate_flag || evacuate_flag)
+                return -1;
+            sched_yield();
+            items = beltItems(state);
+        }
+    } while (!__atomic_compare_exchange_n(&state->beltItemCount, &items, items + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    // A routed slot is only a hint, publishing moves on downstream if it was taken
+    int logical = tableIndex != -1 ? beltFindFreeNearWindow(state, tableIndex) : -1;
+    if (logical == -1)
+        logical = fromLogical;
+
+    plate.dishID = __atomic_fetch_add(&state->nextDishID, 1, __ATOMIC_RELAXED);
+    int physical = publishWord(state, beltPhysicalSlot(state, logical), beltPack(plate));
+    logical = beltLogicalSlot(state, physical);
+    beltNotifyWindow(state, logical);
+    return logical;
+}
+
+int beltClaimForGroup(RestaurantState* state, int physicalStart, int count, int groupID, Dish& dish) {
+    if (beltItems(state) == 0)
+        return -1;
+
+    uint64_t target = beltTargetBits(groupID);
+    for (int j = 0; j < count; ++j) {
+        int i = (physicalStart + j) % BELT_SIZE;
+        uint64_t word = state->belt.slot[i].load(std::memory_order_acquire);
+        if (word == 0 || ((word >> 40) != 0 && (word >> 40) != target))
+            continue;
+
+        // Lost races (another table or the sweep got it) just move on
+        if (state->belt.slot[i].compare_exchange_strong(word, 0, std::memory_order_acquire, std::memory_order_relaxed)) {
+            dish = beltUnpack(word);
+            return i;
         }
     }
-    
-    if (!empty) {
-        Dish last = state->belt[BELT_SIZE - 1];
-        for (int i = BELT_SIZE - 1; i > 0; --i) {
-            state->belt[i] = state->belt[i - 1];
+    return -1;
+}
+
+void beltReturnClaim(RestaurantState* state, int physical, const Dish& dish) {
+    physical = publishWord(state, physical, beltPack(dish));
+    beltNotifyWindow(state, beltLogicalSlot(state, physical));
+}
+#else
+int beltPlaceDish(RestaurantState* state, Dish& plate, int fromLogical, int tableIndex) {
+    for (;;) {
+        int logical = tableIndex != -1 ? beltFindFreeNearWindow(state, tableIndex) : beltFindFreeSlot(state, fromLogical);
+        if (logical == -1)
+            return -1;
+
+        // The search ran unlocked: the slot may have been filled since, so
+        // re-check it with its segment held
+        int physical = beltPhysicalSlot(state, logical);
+        int seg = beltSegmentOf(physical);
+        beltLockSegment(seg);
+
+        if (!beltIsOccupied(state, physical)) {
+            plate.dishID = __atomic_fetch_add(&state->nextDishID, 1, __ATOMIC_RELAXED);
+            beltPut(state, physical, plate);
+            beltUnlockSegment(seg);
+            logical = beltLogicalSlot(state, physical);
+            beltNotifyWindow(state, logical);
+            return logical;
         }
-        state->belt[0] = last;
-        
-        char buffer[128];
-        snprintf(buffer, sizeof(buffer),
-            "\033[34m[%ld] [BELT]: ROTATED\033[0m",
-            time(NULL));
+
+        beltUnlockSegment(seg);
+
+        if (terminate_flag || evacuate_flag)
+            return -1;
     }
-    
-    V(SEM_MUTEX_BELT);
+}
+
+int beltFindForGroup(const RestaurantState* state, int physicalStart, int count, int groupID) {
+    if (beltItems(state) == 0)
+        return -1;
+
+    // Walk the window in logical order; it may wrap past the end of the
+    // physical ring, and the kernels take at most 64 slots at a time
+    int physical = physicalStart;
+    while (count > 0) {
+        int n = BELT_SIZE - physical;
+        if (n > count) n = count;
+        if (n > 64) n = 64;
+
+        uint64_t mask = beltMatchAvailable(state->belt.dishID, state->belt.targetGroupID, physical, n, groupID);
+        if (mask)
+            return physical + __builtin_ctzll(mask);
+
+        count -= n;
+        physical = (physical + n) % BELT_SIZE;
+    }
+    return -1;
+}
+#endif
+
+#if !BELT_LOCKFREE
+void beltInitIndex(RestaurantState* state) {
+    for (int i = 0; i < BELT_SIZE; ++i)
+        state->targetHead[i] = state->targetNext[i] = state->targetPrev[i] = -1;
+}
+
+void beltIndexLink(RestaurantState* state, int physical) {
+    int bucket = state->belt.targetGroupID[physical] % BELT_SIZE;
+
+    P(SEM_MUTEX_TARGETS);
+    int head = state->targetHead[bucket];
+    state->targetNext[physical] = head;
+    state->targetPrev[physical] = -1;
+    if (head != -1) state->targetPrev[head] = physical;
+    state->targetHead[bucket] = physical;
+    V(SEM_MUTEX_TARGETS);
+}
+
+void beltIndexUnlink(RestaurantState* state, int physical) {
+    int bucket = state->belt.targetGroupID[physical] % BELT_SIZE;
+
+    P(SEM_MUTEX_TARGETS);
+    int next = state->targetNext[physical];
+    int prev = state->targetPrev[physical];
+    if (prev != -1) state->targetNext[prev] = next;
+    else state->targetHead[bucket] = next;
+    if (next != -1) state->targetPrev[next] = prev;
+    state->targetNext[physical] = state->targetPrev[physical] = -1;
+    V(SEM_MUTEX_TARGETS);
+}
+
+int beltTargetedSlots(const RestaurantState* state, int groupID, int* out, int max) {
+    int n = 0;
+
+    // Other groups may share the bucket, so filter by the slot's target
+    P(SEM_MUTEX_TARGETS);
+    for (int i = state->targetHead[groupID % BELT_SIZE]; i != -1 && n < max; i = state->targetNext[i])
+        if (state->belt.targetGroupID[i] == groupID)
+            out[n++] = i;
+    V(SEM_MUTEX_TARGETS);
+
+    return n;
+}
+#endif
+
+int beltNextOccupied(const RestaurantState* state, int fromPhysical) {
+    if (beltItems(state) == 0)
+        return -1;
+    return findSlot(state, fromPhysical, BELT_SIZE, true);
+}
+
+int beltPopcount(const RestaurantState* state) {
+    int total = 0;
+#if BELT_LOCKFREE
+    for (int i = 0; i < BELT_SIZE; ++i)
+        total += beltIsOccupied(state, i);
+#else
+    for (int w = 0; w < BELT_WORDS; ++w)
+        total += __builtin_popcountll(__atomic_load_n(&state->beltOccupied[w], __ATOMIC_RELAXED) & validMask(w));
+#endif
+    return total;
+}
+
+// Rotates the conveyor belt by one position.
+// Dishes stay in their physical slots; advancing the offset moves every
+// logical position (and the last one wraps to the first) in O(1).
+// Segment locks cover physical slots, so no lock is needed: a consumer that
+// read the old offset simply sees its window one step late.
+void rotateBelt(RestaurantState* state) {
+    if (beltItems(state) == 0)
+        return;
+
+    int offset = __atomic_load_n(&state->beltOffset, __ATOMIC_RELAXED);
+    __atomic_store_n(&state->beltOffset, (offset + 1) % BELT_SIZE, __ATOMIC_RELAXED);
+
+#if DISH_NOTIFY
+    // Every window moved one step: wake the tables a dish just rolled into
+    for (int t = 0; t < TABLE_COUNT; ++t) {
+        if (beltIsOccupied(state, beltPhysicalSlot(state, beltWindowStart(t))))
+            eventNotify(&state->windowDish[t]);
+    }
+#endif
+}
+
+void beltNotifyWindow(RestaurantState* state, int logical) {
+#if DISH_NOTIFY
+    // Windows start at multiples of BELT_WINDOW_SLOTS and repeat every lap
+    int lap = BELT_SIZE / BELT_WINDOW_SLOTS;
+    for (int t = logical / BELT_WINDOW_SLOTS; t < TABLE_COUNT; t += lap)
+        eventNotify(&state->windowDish[t]);
+#endif
 }
 
 // Main belt process loop
@@ -39,6 +281,7 @@ void startBelt() {
     while (!terminate_flag && !evacuate_flag) {
         SIM_SLEEP(500000); // 500ms rotation interval
         rotateBelt(state);
+        sched_yield(); // Rotation makes no syscall; don't hog the CPU when delays are skipped
     }
     
     fifoCloseWrite();
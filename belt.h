@@ -1,8 +1,220 @@
 ﻿#pragma once
 #include "ipc_manager.h"
+#include "belt_scan.h"
+
+// Locking protocol: the physical ring is split into BELT_SEGMENTS runs of
+// BELT_WINDOW_SLOTS slots, each with its own SEM_BELT_SEGMENT lock. Dishes
+// never move between physical slots, so a segment lock pins its dishes
+// whatever the rotation does.
+//  - A consumer snapshots where its table window lies physically and locks
+//    the one or two segments it covers (lower index first).
+//  - The chef searches for a free slot without a lock, then locks the
+//    segment of that slot and re-checks it before placing the dish.
+//  - The zombie sweep locks one segment at a time.
+//  - The targeted dish index has its own lock (SEM_MUTEX_TARGETS), taken
+//    after a segment lock and never held while acquiring one.
+//  - Rotation only advances beltOffset (atomically) and takes no lock.
+// Nobody holds more than two segments and pairs are taken in ascending
+// order, so the protocol cannot deadlock. The occupancy bitmap and item
+// counter are shared by all segments and are updated with atomic operations.
+
+static inline int beltSegmentOf(int physical) {
+    int seg = physical / BELT_WINDOW_SLOTS;
+    return seg < BELT_SEGMENTS ? seg : BELT_SEGMENTS - 1;
+}
+
+static inline int beltSegmentBegin(int seg) { return seg * BELT_WINDOW_SLOTS; }
+static inline int beltSegmentEnd(int seg) { return seg == BELT_SEGMENTS - 1 ? BELT_SIZE : (seg + 1) * BELT_WINDOW_SLOTS; }
+
+static inline void beltLockSegment(int seg) { P(SEM_BELT_SEGMENT + seg); }
+static inline void beltUnlockSegment(int seg) { V(SEM_BELT_SEGMENT + seg); }
+
+// Locks the segments covering count physical slots from physicalStart
+// (at most BELT_WINDOW_SLOTS, so at most two segments). Returns them in
+// segs[0..1]; segs[1] is -1 when the window fits in one segment.
+static inline void beltLockWindow(int physicalStart, int count, int segs[2]) {
+    int first = beltSegmentOf(physicalStart);
+    int last = beltSegmentOf((physicalStart + count - 1) % BELT_SIZE);
+    segs[0] = first < last ? first : last;
+    segs[1] = first == last ? -1 : (first < last ? last : first);
+    beltLockSegment(segs[0]);
+    if (segs[1] != -1) beltLockSegment(segs[1]);
+}
+
+static inline void beltUnlockWindow(const int segs[2]) {
+    if (segs[1] != -1) beltUnlockSegment(segs[1]);
+    beltUnlockSegment(segs[0]);
+}
+
+// Logical positions are fixed relative to the tables (table windows, logs),
+// physical slots are indices into RestaurantState::belt. Rotating the belt
+// only advances beltOffset, so every access must go through these helpers.
+static inline int beltPhysicalSlot(const RestaurantState* state, int logical) {
+    int offset = __atomic_load_n(&state->beltOffset, __ATOMIC_RELAXED);
+    return (logical - offset + BELT_SIZE) % BELT_SIZE;
+}
+
+static inline int beltLogicalSlot(const RestaurantState* state, int physical) {
+    int offset = __atomic_load_n(&state->beltOffset, __ATOMIC_RELAXED);
+    return (physical + offset) % BELT_SIZE;
+}
+
+// First logical position of a table's window
+static inline int beltWindowStart(int tableIndex) {
+    return (tableIndex * BELT_WINDOW_SLOTS) % BELT_SIZE;
+}
+
+// Wakes the diners of every table whose window holds logical (DISH_NOTIFY)
+void beltNotifyWindow(RestaurantState* state, int logical);
+
+// Number of dishes on the belt, safe to read without any belt lock
+static inline int beltItems(const RestaurantState* state) {
+    return __atomic_load_n(&state->beltItemCount, __ATOMIC_RELAXED);
+}
+
+#if BELT_LOCKFREE
+// Lock-free mode: the segment locks above are unused. Every slot is a single
+// packed word, claimed (word -> 0) and published (0 -> word) with CAS.
+// beltItemCount is the slot reservation counter: the chef raises it before
+// publishing, and a claimed dish keeps its unit until the claimer either
+// releases it (eaten) or returns the dish to the belt. So a reserving or
+// returning process always finds an empty slot to publish into.
+
+// Packed slot word: dishID in bits 0-31, color in bits 32-39 and
+// targetGroupID + 1 in bits 40-63 (0 = anyone). The price follows the color.
+static inline uint64_t beltTargetBits(int groupID) {
+    return (uint64_t)(groupID + 1) & 0xFFFFFF;
+}
+
+static inline uint64_t beltPack(const Dish& d) {
+    return (uint64_t)(uint32_t)d.dishID | (uint64_t)d.color << 32 | beltTargetBits(d.targetGroupID) << 40;
+}
+
+static inline Dish beltUnpack(uint64_t word) {
+    Dish d;
+    d.dishID = (int)(uint32_t)word;
+    d.color = (colors)((word >> 32) & 0xFF);
+    d.price = priceForColor(d.color);
+    d.targetGroupID = (int)(word >> 40) - 1;
+    return d;
+}
+
+static inline bool beltIsOccupied(const RestaurantState* state, int physical) {
+    return state->belt.slot[physical].load(std::memory_order_relaxed) != 0;
+}
+
+static inline Dish beltGet(const RestaurantState* state, int physical) {
+    return beltUnpack(state->belt.slot[physical].load(std::memory_order_acquire));
+}
+
+// Claims the slot if it holds a dish targeted at groupID (zombie sweep)
+static inline bool beltClaimTargeted(RestaurantState* state, int physical, int groupID, Dish& dish) {
+    uint64_t word = state->belt.slot[physical].load(std::memory_order_acquire);
+    if (word == 0 || (word >> 40) != beltTargetBits(groupID))
+        return false;
+    if (!state->belt.slot[physical].compare_exchange_strong(word, 0, std::memory_order_acquire, std::memory_order_relaxed))
+        return false;
+    dish = beltUnpack(word);
+    return true;
+}
+
+// Gives up the reservation unit of a claimed dish once it left the belt for good
+static inline void beltReleaseClaim(RestaurantState* state) {
+    __atomic_fetch_sub(&state->beltItemCount, 1, __ATOMIC_RELAXED);
+}
+
+// Claims the first dish available to groupID among count physical slots
+// starting at physicalStart (wrapping). Returns its physical slot, or -1.
+int beltClaimForGroup(RestaurantState* state, int physicalStart, int count, int groupID, Dish& dish);
+
+// Puts a claimed dish back, in its old slot if still empty or the next empty one
+void beltReturnClaim(RestaurantState* state, int physical, const Dish& dish);
+#else
+// Occupancy bitmap bookkeeping, must be kept in sync with belt.dishID[].
+// Writers must hold the segment lock of the slot.
+static inline bool beltIsOccupied(const RestaurantState* state, int physical) {
+    return (__atomic_load_n(&state->beltOccupied[physical >> 6], __ATOMIC_RELAXED) >> (physical & 63)) & 1;
+}
+
+static inline void beltMarkOccupied(RestaurantState* state, int physical) {
+    __atomic_fetch_or(&state->beltOccupied[physical >> 6], 1ULL << (physical & 63), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state->beltItemCount, 1, __ATOMIC_RELAXED);
+}
+
+static inline void beltMarkFree(RestaurantState* state, int physical) {
+    __atomic_fetch_and(&state->beltOccupied[physical >> 6], ~(1ULL << (physical & 63)), __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&state->beltItemCount, 1, __ATOMIC_RELAXED);
+}
+
+// Targeted dish index, so a group's dishes are found without walking the
+// belt. Link/unlink take SEM_MUTEX_TARGETS and are called by beltPut/beltTake.
+void beltInitIndex(RestaurantState* state);
+void beltIndexLink(RestaurantState* state, int physical);
+void beltIndexUnlink(RestaurantState* state, int physical);
+
+// Copies up to max physical slots holding dishes targeted at groupID into
+// out and returns their number. Only a snapshot: re-check each slot with
+// its segment held.
+int beltTargetedSlots(const RestaurantState* state, int groupID, int* out, int max);
+
+// Slot accessors over the SoA lanes; they keep the occupancy bitmap and the
+// targeted dish index in sync. Caller must hold the segment lock of the slot.
+static inline void beltPut(RestaurantState* state, int physical, const Dish& d) {
+    state->belt.dishID[physical] = d.dishID;
+    state->belt.color[physical] = d.color;
+    state->belt.price[physical] = d.price;
+    state->belt.targetGroupID[physical] = d.targetGroupID;
+    beltMarkOccupied(state, physical);
+    if (d.targetGroupID != -1) beltIndexLink(state, physical);
+}
+
+static inline Dish beltGet(const RestaurantState* state, int physical) {
+    Dish d;
+    d.dishID = state->belt.dishID[physical];
+    d.color = state->belt.color[physical];
+    d.price = state->belt.price[physical];
+    d.targetGroupID = state->belt.targetGroupID[physical];
+    return d;
+}
+
+static inline void beltTake(RestaurantState* state, int physical) {
+    if (state->belt.targetGroupID[physical] != -1) beltIndexUnlink(state, physical);
+    state->belt.dishID[physical] = 0;
+    state->belt.targetGroupID[physical] = -1;
+    beltMarkFree(state, physical);
+}
+
+// Returns the physical slot of the first dish available to groupID among
+// count physical slots starting at physicalStart (wrapping), or -1.
+// Caller must hold the window (beltLockWindow).
+int beltFindForGroup(const RestaurantState* state, int physicalStart, int count, int groupID);
+#endif
+
+// Places plate in the first free logical position at or after fromLogical,
+// or, with tableIndex != -1, as close upstream of that table's window as
+// possible (beltFindFreeNearWindow). Assigns its dishID and takes the
+// segment lock of the chosen slot itself (lock-free mode: reserves a slot,
+// waiting while the belt is full, and publishes with CAS). Returns the
+// logical position, or -1 if the belt is full or the simulation is stopping.
+int beltPlaceDish(RestaurantState* state, Dish& plate, int fromLogical, int tableIndex = -1);
+
+// Returns the first free logical position at or after fromLogical (wrapping),
+// or -1 if the belt is full. Only a hint unless the slot's segment is held.
+int beltFindFreeSlot(const RestaurantState* state, int fromLogical);
+
+// Returns the free logical position that reaches tableIndex's window first:
+// inside the window (from its start), else the nearest one upstream.
+// -1 if the belt is full. Only a hint unless the slot's segment is held.
+int beltFindFreeNearWindow(const RestaurantState* state, int tableIndex);
+
+// Returns the first occupied physical slot at or after fromPhysical, or -1
+int beltNextOccupied(const RestaurantState* state, int fromPhysical);
+
+// Counts occupied slots straight from the slots (cross-check for beltItemCount)
+int beltPopcount(const RestaurantState* state);
 
 // Starts the Belt process loop
 void startBelt();
 
-// Rotates the belt one step
+// Rotates the belt one step (lock-free, see the protocol above)
 void rotateBelt(RestaurantState* state);
@@ -0,0 +1,75 @@
+﻿#include "belt_scan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BELT_SCAN_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BELT_SCAN_KERNEL "sse2"
+#else
+#define BELT_SCAN_KERNEL "scalar"
+#endif
+
+// Reference implementation, also used for the tail of the vector loops
+static inline uint64_t matchScalar(const int* dishID, const int* targetGroupID,
+    int begin, int count, int groupID, int from)
+{
+    uint64_t mask = 0;
+    for (int j = from; j < count; ++j) {
+        int t = targetGroupID[begin + j];
+        if (dishID[begin + j] != 0 && (t == groupID || t == -1))
+            mask |= 1ULL << j;
+    }
+    return mask;
+}
+
+static inline uint64_t matchKernel(const int* dishID, const int* targetGroupID,
+    int begin, int count, int groupID)
+{
+    uint64_t mask = 0;
+    int j = 0;
+
+#if defined(__AVX2__)
+    const __m256i vGroup = _mm256_set1_epi32(groupID);
+    const __m256i vShared = _mm256_set1_epi32(-1);
+    const __m256i vZero = _mm256_setzero_si256();
+
+    for (; j + 8 <= count; j += 8) {
+        __m256i ids = _mm256_loadu_si256((const __m256i*)(dishID + begin + j));
+        __m256i tgt = _mm256_loadu_si256((const __m256i*)(targetGroupID + begin + j));
+
+        __m256i want = _mm256_or_si256(_mm256_cmpeq_epi32(tgt, vGroup), _mm256_cmpeq_epi32(tgt, vShared));
+        __m256i hit = _mm256_andnot_si256(_mm256_cmpeq_epi32(ids, vZero), want);
+
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(hit)) << j;
+    }
+#elif defined(__SSE2__)
+    const __m128i vGroup = _mm_set1_epi32(groupID);
+    const __m128i vShared = _mm_set1_epi32(-1);
+    const __m128i vZero = _mm_setzero_si128();
+
+    for (; j + 4 <= count; j += 4) {
+        __m128i ids = _mm_loadu_si128((const __m128i*)(dishID + begin + j));
+        __m128i tgt = _mm_loadu_si128((const __m128i*)(targetGroupID + begin + j));
+
+        __m128i want = _mm_or_si128(_mm_cmpeq_epi32(tgt, vGroup), _mm_cmpeq_epi32(tgt, vShared));
+        __m128i hit = _mm_andnot_si128(_mm_cmpeq_epi32(ids, vZero), want);
+
+        mask |= (uint64_t)(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hit)) << j;
+    }
+#endif
+
+    return mask | matchScalar(dishID, targetGroupID, begin, count, groupID, j);
+}
+
+uint64_t beltMatchAvailable(const int* dishID, const int* targetGroupID, int begin, int count, int groupID) {
+    return matchKernel(dishID, targetGroupID, begin, count, groupID);
+}
+
+uint64_t beltMatchAvailableScalar(const int* dishID, const int* targetGroupID, int begin, int count, int groupID) {
+    return matchScalar(dishID, targetGroupID, begin, count, groupID, 0);
+}
+
+const char* beltScanKernelName() {
+    return BELT_SCAN_KERNEL;
+}
@@ -0,0 +1,18 @@
+﻿#pragma once
+#include <stdint.h>
+
+// Vectorized compare-and-mask kernels over the SoA belt lanes.
+// The implementation (AVX2, SSE2 or scalar) is picked at build time from the
+// compiler target flags, e.g. `make SIMD_FLAGS=-mavx2`.
+//
+// Each kernel looks at count (<= 64) physical slots starting at begin and
+// returns a bitmask where bit j is set if slot begin+j matches.
+
+// Slots holding a dish that groupID may take: untargeted or targeted at groupID
+uint64_t beltMatchAvailable(const int* dishID, const int* targetGroupID, int begin, int count, int groupID);
+
+// Plain scalar version, always available for comparison
+uint64_t beltMatchAvailableScalar(const int* dishID, const int* targetGroupID, int begin, int count, int groupID);
+
+// Name of the kernel set selected at build time ("avx2", "sse2" or "scalar")
+const char* beltScanKernelName();
@@ -0,0 +1,126 @@
+﻿// Contention benchmark: every table eats from the belt at once.
+// Each table process repeatedly locks its window, takes a dish and puts it
+// back, while the belt keeps rotating. Compares one global belt lock with
+// the per-segment locks used by the simulation, or measures the CAS slots
+// when built with make bench MODE_FLAGS=-DBELT_LOCKFREE=1.
+#include "belt.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const int RUN_MS = 2000;
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fillBelt() {
+    memset((void*)state, 0, sizeof(RestaurantState));
+    for (int i = 0; i < BELT_SIZE; ++i) {
+        Dish d{};
+        d.dishID = i + 1;
+        d.color = colorFromIndex(i % COLOR_COUNT);
+        d.price = priceForColor(d.color);
+        d.targetGroupID = -1;
+#if BELT_LOCKFREE
+        state->belt.slot[i].store(beltPack(d));
+        state->beltItemCount++;
+#else
+        beltPut(state, i, d);
+#endif
+    }
+}
+
+// One table: take the first visible dish and put it back, as fast as possible
+static void tableLoop(int table, bool segmented, long* ops) {
+    int startSlot = (table * BELT_WINDOW_SLOTS) % BELT_SIZE;
+    long done = 0;
+    double end = nowMs() + RUN_MS;
+
+    while (nowMs() < end) {
+        int windowStart = beltPhysicalSlot(state, startSlot);
+#if BELT_LOCKFREE
+        (void)segmented;
+        Dish d;
+        int physical = beltClaimForGroup(state, windowStart, BELT_WINDOW_SLOTS, table, d);
+        if (physical != -1) {
+            beltReturnClaim(state, physical, d);
+            done++;
+        }
+#else
+        int segments[2] = { 0, -1 };
+
+        if (segmented) beltLockWindow(windowStart, BELT_WINDOW_SLOTS, segments);
+        else beltLockSegment(0);
+
+        int physical = beltFindForGroup(state, windowStart, BELT_WINDOW_SLOTS, table);
+        if (physical != -1) {
+            Dish d = beltGet(state, physical);
+            beltTake(state, physical);
+            beltPut(state, physical, d);
+            done++;
+        }
+
+        if (segmented) beltUnlockWindow(segments);
+        else beltUnlockSegment(0);
+#endif
+    }
+
+    __atomic_fetch_add(ops, done, __ATOMIC_RELAXED);
+}
+
+static void run(const char* name, bool segmented, long* ops) {
+    fillBelt();
+    *ops = 0;
+
+    pid_t rotator = fork();
+    if (rotator == 0) {
+        for (;;) rotateBelt(state);
+    }
+
+    for (int t = 0; t < TABLE_COUNT; ++t) {
+        if (fork() == 0) {
+            tableLoop(t, segmented, ops);
+            _exit(0);
+        }
+    }
+    for (int t = 0; t < TABLE_COUNT; ++t) wait(NULL);
+
+    kill(rotator, SIGKILL);
+    waitpid(rotator, NULL, 0);
+
+    printf("  %-10s %10.0f takes/s  (belt items %d, bitmap %d)\n",
+        name, *ops * 1000.0 / RUN_MS, beltItems(state), beltPopcount(state));
+}
+
+int main() {
+    // Same layout as ipcInit: state, then the futex semaphores, then the counter
+    semId = semget(IPC_PRIVATE, SEM_COUNT, IPC_CREAT | 0600);
+    shmId = shmget(IPC_PRIVATE, sizeof(RestaurantState) + SEM_COUNT * sizeof(FutexSem) + sizeof(long), IPC_CREAT | 0600);
+    if (semId == -1 || shmId == -1) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    state = (RestaurantState*)shmat(shmId, NULL, 0);
+    semTable = (FutexSem*)(state + 1);
+    long* ops = (long*)(semTable + SEM_COUNT);
+
+    for (int i = 0; i < BELT_SEGMENTS; ++i)
+        semSet(SEM_BELT_SEGMENT + i, 1);
+
+    printf("tables=%d belt=%d segments=%d window=%d cpus=%ld\n",
+        TABLE_COUNT, BELT_SIZE, BELT_SEGMENTS, BELT_WINDOW_SLOTS, sysconf(_SC_NPROCESSORS_ONLN));
+#if BELT_LOCKFREE
+    run("lock-free", false, ops);
+#else
+    run("global", false, ops);
+    run("segmented", true, ops);
+#endif
+
+    shmdt(state);
+    shmctl(shmId, IPC_RMID, NULL);
+    semctl(semId, 0, IPC_RMID);
+    return 0;
+}
@@ -0,0 +1,107 @@
+﻿// Microbenchmark: consumer window match over the belt.
+// Compares the old array-of-structs walk with the SoA scalar kernel and the
+// SIMD kernel selected at build time (make bench SIMD_FLAGS=-mavx2).
+#include "common.h"
+#include "belt_scan.h"
+#include <vector>
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const int GROUPS = 64;
+static volatile long sink = 0;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+struct Belt {
+    std::vector<Dish> aos;
+    std::vector<int> dishID, targetGroupID;
+
+    explicit Belt(int size) : aos(size), dishID(size), targetGroupID(size) {
+        for (int i = 0; i < size; ++i) {
+            Dish d{};
+            d.targetGroupID = -1;
+            if (rand() % 100 < 60) {
+                d.dishID = i + 1;
+                d.color = colorFromIndex(rand() % COLOR_COUNT);
+                d.price = priceForColor(d.color);
+                if (rand() % 100 < 20) d.targetGroupID = rand() % GROUPS;
+            }
+            aos[i] = d;
+            dishID[i] = d.dishID;
+            targetGroupID[i] = d.targetGroupID;
+        }
+    }
+};
+
+// Old layout: first dish in [begin, begin+count) available to groupID
+static int aosFind(const Belt& b, int begin, int count, int groupID) {
+    for (int j = 0; j < count; ++j) {
+        const Dish& d = b.aos[begin + j];
+        if (d.dishID != 0 && (d.targetGroupID == -1 || d.targetGroupID == groupID))
+            return begin + j;
+    }
+    return -1;
+}
+
+typedef uint64_t (*Kernel)(const int*, const int*, int, int, int);
+
+static int soaFind(const Belt& b, Kernel k, int begin, int count, int groupID) {
+    while (count > 0) {
+        int n = count > 64 ? 64 : count;
+        uint64_t mask = k(b.dishID.data(), b.targetGroupID.data(), begin, n, groupID);
+        if (mask) return begin + __builtin_ctzll(mask);
+        begin += n;
+        count -= n;
+    }
+    return -1;
+}
+
+static void runSize(int size, int iterations) {
+    Belt b(size);
+    int window = size / TABLE_COUNT;
+    if (window < 1) window = 1;
+    int windows = size / window;
+
+    printf("belt=%d window=%d\n", size, window);
+
+    double t0 = nowNs();
+    for (int it = 0; it < iterations; ++it)
+        for (int w = 0; w < windows; ++w) sink += aosFind(b, w * window, window, it % GROUPS);
+    double tAos = (nowNs() - t0) / ((double)iterations * windows);
+
+    t0 = nowNs();
+    for (int it = 0; it < iterations; ++it)
+        for (int w = 0; w < windows; ++w) sink += soaFind(b, beltMatchAvailableScalar, w * window, window, it % GROUPS);
+    double tScalar = (nowNs() - t0) / ((double)iterations * windows);
+
+    t0 = nowNs();
+    for (int it = 0; it < iterations; ++it)
+        for (int w = 0; w < windows; ++w) sink += soaFind(b, beltMatchAvailable, w * window, window, it % GROUPS);
+    double tSimd = (nowNs() - t0) / ((double)iterations * windows);
+
+    printf("  window match: aos %.1f ns  soa-scalar %.1f ns  soa-%s %.1f ns\n",
+        tAos, tScalar, beltScanKernelName(), tSimd);
+
+    // Kernels must agree with the struct walk
+    for (int g = 0; g < GROUPS; ++g) {
+        if (aosFind(b, 0, window, g) != soaFind(b, beltMatchAvailable, 0, window, g)) {
+            printf("  - MISMATCH for groupID=%d\n", g);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main() {
+    srand(155187);
+    printf("kernel: %s\n", beltScanKernelName());
+
+    runSize(BELT_SIZE, 200000);
+    runSize(300, 100000);
+    runSize(4096, 10000);
+    return 0;
+}
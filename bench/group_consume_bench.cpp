@@ -0,0 +1,136 @@
+﻿// Consume throughput on one group's counters: its diners (threads) eat until
+// the group's dishes run out, calling what a person calls on every pass
+// (isFinished, getTableIndex, consumeOneDish, getDishesToEat). Compares the
+// lock-free Group counters with the mutex-guarded layout they replaced.
+#include "client.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+int Group::nextGroupID = 0;
+
+static const int DISHES = 2000000;
+static const int ROUNDS = 5;
+
+// Previous Group counters: every getter and mutation under the group mutex
+class MutexGroup {
+private:
+    int dishesToEat;
+    int tableIndex;
+    int eatenCount[COLOR_COUNT];
+    pthread_mutex_t mutex;
+
+public:
+    explicit MutexGroup(int dishes) : dishesToEat(dishes), tableIndex(0) {
+        memset(eatenCount, 0, sizeof(eatenCount));
+        pthread_mutex_init(&mutex, nullptr);
+    }
+
+    ~MutexGroup() { pthread_mutex_destroy(&mutex); }
+
+    int getDishesToEat() {
+        pthread_mutex_lock(&mutex);
+        int v = dishesToEat;
+        pthread_mutex_unlock(&mutex);
+        return v;
+    }
+
+    int getTableIndex() {
+        pthread_mutex_lock(&mutex);
+        int v = tableIndex;
+        pthread_mutex_unlock(&mutex);
+        return v;
+    }
+
+    bool consumeOneDish(colors c) {
+        pthread_mutex_lock(&mutex);
+        if (dishesToEat <= 0) {
+            pthread_mutex_unlock(&mutex);
+            return false;
+        }
+
+        dishesToEat--;
+        int idx = colorToIndex(c);
+        if (idx >= 0 && idx < COLOR_COUNT)
+            eatenCount[idx]++;
+
+        pthread_mutex_unlock(&mutex);
+        return true;
+    }
+
+    bool isFinished() {
+        pthread_mutex_lock(&mutex);
+        bool done = (dishesToEat <= 0);
+        pthread_mutex_unlock(&mutex);
+        return done;
+    }
+};
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+template<typename G>
+static void* diner(void* arg) {
+    G& g = *(G*)arg;
+    int c = 0;
+    long checksum = 0;
+
+    while (!g.isFinished()) {
+        if (g.getTableIndex() < 0)
+            continue;
+        if (g.consumeOneDish(colorFromIndex(c++ % COLOR_COUNT)))
+            checksum += g.getDishesToEat();
+    }
+    return (void*)checksum;
+}
+
+// Best of ROUNDS, in million dishes per second
+template<typename G>
+static double run(int diners, G* (*make)()) {
+    double best = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        G* g = make();
+        pthread_t threads[diners];
+
+        double start = nowMs();
+        for (int i = 0; i < diners; ++i)
+            pthread_create(&threads[i], nullptr, diner<G>, g);
+        for (int i = 0; i < diners; ++i)
+            pthread_join(threads[i], nullptr);
+        double ms = nowMs() - start;
+
+        int left = g->getDishesToEat();
+        if (left != 0) {
+            printf("ERROR: %d dishes left\n", left);
+            exit(1);
+        }
+        delete g;
+
+        double rate = DISHES / ms / 1e3;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+static MutexGroup* makeMutexGroup() {
+    return new MutexGroup(DISHES);
+}
+
+static Group* makeAtomicGroup() {
+    GroupSpec spec = { 0, MAX_GROUP_SIZE, MAX_GROUP_SIZE, 0, false, DISHES, 0, 0 };
+    Group* g = new Group(spec);
+    g->setTableIndex(0);
+    return g;
+}
+
+int main() {
+    printf("%d dishes per group, best of %d runs (Mdishes/s)\n", DISHES, ROUNDS);
+    printf("%-8s %10s %10s\n", "diners", "mutex", "atomic");
+
+    int diners[] = { 1, 4 };
+    for (int d : diners)
+        printf("%-8d %10.2f %10.2f\n", d, run(d, makeMutexGroup), run(d, makeAtomicGroup));
+    return 0;
+}
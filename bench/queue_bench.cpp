@@ -0,0 +1,78 @@
+﻿// Request transport throughput: several producer processes push
+// ClientRequests through queueSendRequest() while one consumer drains them
+// with queueRecvRequest(), as the groups and the service do. Build with
+// MODE_FLAGS=-DSHM_QUEUES=0 to measure the SysV message queue instead.
+#include "ipc_manager.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const int PRODUCERS = 4;
+static const int PER_PRODUCER = 200000;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main() {
+    // Same layout as ipcInit: semaphores, then the rings
+    size_t shmSize = SEM_COUNT * sizeof(FutexSem) + sizeof(MsgRings);
+    shmId = shmget(IPC_PRIVATE, shmSize, IPC_CREAT | 0600);
+    clientQid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+#if !FUTEX_SEMAPHORES
+    semId = semget(IPC_PRIVATE, SEM_COUNT, IPC_CREAT | 0600);
+#endif
+    if (shmId == -1 || clientQid == -1 || (semId == -1 && !FUTEX_SEMAPHORES)) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    char* base = (char*)shmat(shmId, NULL, 0);
+    memset(base, 0, shmSize);
+    semTable = (FutexSem*)base;
+    msgRings = (MsgRings*)(base + SEM_COUNT * sizeof(FutexSem));
+    for (int i = 0; i < CLIENT_QUEUE_SIZE; ++i)
+        msgRings->client.cells[i].seq = i;
+
+    semSet(SEM_CLIENT_FREE, CLIENT_QUEUE_SIZE);
+    semSet(SEM_CLIENT_ITEMS, 0);
+
+    double t0 = nowNs();
+    for (int p = 0; p < PRODUCERS; ++p) {
+        if (fork() == 0) {
+            ClientRequest req = {};
+            req.mtype = 1;
+            req.pid = getpid();
+            for (int i = 0; i < PER_PRODUCER; ++i) {
+                req.groupID = i;
+                queueSendRequest(req);
+            }
+            _exit(0);
+        }
+    }
+
+    long checksum = 0;
+    for (int i = 0; i < PRODUCERS * PER_PRODUCER; ++i) {
+        ClientRequest req;
+        queueRecvRequest(req, 0);
+        checksum += req.groupID;
+    }
+    double elapsed = nowNs() - t0;
+    while (wait(NULL) > 0) {}
+
+    long expected = (long)PRODUCERS * PER_PRODUCER * (PER_PRODUCER - 1) / 2;
+    printf("transport: %s, cpus=%ld, producers=%d\n", SHM_QUEUES ? "shm ring" : "sysv msg",
+        sysconf(_SC_NPROCESSORS_ONLN), PRODUCERS);
+    printf("  %.2f M msgs/s  (%.1f ns/msg)%s\n",
+        PRODUCERS * PER_PRODUCER / elapsed * 1e3, elapsed / (PRODUCERS * PER_PRODUCER),
+        checksum == expected ? "" : "  CHECKSUM MISMATCH");
+
+    shmdt(base);
+    shmctl(shmId, IPC_RMID, NULL);
+    msgctl(clientQid, IPC_RMID, NULL);
+#if !FUTEX_SEMAPHORES
+    semctl(semId, 0, IPC_RMID);
+#endif
+    return 0;
+}
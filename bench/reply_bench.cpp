@@ -0,0 +1,107 @@
+﻿// Seating reply latency against the number of waiting groups: W processes
+// block in groupReplyRecv(), the parent answers them one at a time in random
+// order and waits for each to acknowledge. Build with
+// MODE_FLAGS=-DGROUP_MAILBOXES=0 to measure serviceQid with mtype=pid.
+#include "ipc_manager.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const int MAX_WAITERS = 1000;
+
+struct BenchShared {
+    int ready;
+    int mailbox[MAX_WAITERS];
+    int acked[MAX_WAITERS];
+    long long sentNs[MAX_WAITERS];
+    long long latencyNs[MAX_WAITERS];
+};
+
+static long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double run(BenchShared* b, int waiters) {
+    memset(b, 0, sizeof(*b));
+    pid_t pids[MAX_WAITERS];
+
+    for (int i = 0; i < waiters; ++i) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int mailbox = groupMailboxOpen(getpid(), i);
+            b->mailbox[i] = mailbox;
+            __atomic_fetch_add(&b->ready, 1, __ATOMIC_SEQ_CST);
+
+            ServiceRequest resp{};
+            groupReplyRecv(mailbox, getpid(), resp);
+            b->latencyNs[i] = nowNs() - b->sentNs[i];
+            groupMailboxClose(mailbox);
+            __atomic_store_n(&b->acked[i], 1, __ATOMIC_SEQ_CST);
+            _exit(0);
+        }
+    }
+    while (__atomic_load_n(&b->ready, __ATOMIC_SEQ_CST) < waiters)
+        sched_yield();
+    usleep(100000); // Let every child park in its receive
+
+    int order[MAX_WAITERS];
+    for (int i = 0; i < waiters; ++i) order[i] = i;
+    for (int i = waiters - 1; i > 0; --i) {
+        int j = rand() % (i + 1);
+        int t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+
+    for (int k = 0; k < waiters; ++k) {
+        int i = order[k];
+        ServiceRequest msg{};
+        msg.mtype = pids[i];
+        msg.type = REQ_GROUP_ASSIGNED;
+        msg.extraData = 0;
+        b->sentNs[i] = nowNs();
+        groupReplySend(b->mailbox[i], msg);
+        while (!__atomic_load_n(&b->acked[i], __ATOMIC_SEQ_CST))
+            sched_yield();
+    }
+    while (wait(NULL) > 0) {}
+
+    long long sum = 0;
+    for (int i = 0; i < waiters; ++i) sum += b->latencyNs[i];
+    return (double)sum / waiters;
+}
+
+int main() {
+    size_t shmSize = SEM_COUNT * sizeof(FutexSem) + sizeof(GroupRegistry) + sizeof(BenchShared);
+    shmId = shmget(IPC_PRIVATE, shmSize, IPC_CREAT | 0600);
+    serviceQid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+#if !FUTEX_SEMAPHORES
+    semId = semget(IPC_PRIVATE, SEM_COUNT, IPC_CREAT | 0600);
+#endif
+    if (shmId == -1 || serviceQid == -1 || (semId == -1 && !FUTEX_SEMAPHORES)) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    char* base = (char*)shmat(shmId, NULL, 0);
+    memset(base, 0, shmSize);
+    semTable = (FutexSem*)base;
+    groupRegistry = (GroupRegistry*)(base + SEM_COUNT * sizeof(FutexSem));
+    BenchShared* b = (BenchShared*)(base + SEM_COUNT * sizeof(FutexSem) + sizeof(GroupRegistry));
+
+    semSet(SEM_SERVICE_FREE, SERVICE_QUEUE_SIZE);
+    semSet(SEM_SERVICE_ITEMS, 0);
+
+    printf("replies: %s, cpus=%ld\n", GROUP_MAILBOXES ? "group mailboxes" : "serviceQid mtype=pid",
+        sysconf(_SC_NPROCESSORS_ONLN));
+    const int sizes[] = { 10, 100, 1000 };
+    for (int waiters : sizes)
+        printf("  %4d waiting: %.1f us per reply\n", waiters, run(b, waiters) / 1000.0);
+
+    shmdt(base);
+    shmctl(shmId, IPC_RMID, NULL);
+    msgctl(serviceQid, IPC_RMID, NULL);
+#if !FUTEX_SEMAPHORES
+    semctl(semId, 0, IPC_RMID);
+#endif
+    return 0;
+}
@@ -0,0 +1,101 @@
+﻿// Table assignment cost: a stream of random arrivals is seated with
+// assignTable() under the default policy (SEATING_POLICY); whenever nobody
+// fits, a random seated group leaves. Reports time per assignTable() call and the average
+// share of occupied seats. Compare with make bench MODE_FLAGS=-DSEATING_POLICY=0.
+#include "seating.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+int assignTable(RestaurantState* state, bool vipStatus, int groupSize, int groupID, pid_t pid, int mailbox);
+
+static const int ROUNDS = 1000000;
+
+struct Seated {
+    int table;
+    pid_t pid;
+};
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void initTables() {
+    memset((void*)state, 0, sizeof(RestaurantState));
+    for (int i = 0; i < TABLE_COUNT; ++i) {
+        Table& t = state->tables[i];
+        t.tableID = i;
+        t.capacity = i < X1 ? 1 : i < X1 + X2 ? 2 : i < X1 + X2 + X3 ? 3 : 4;
+        for (int s = 0; s < MAX_TABLE_SLOTS; ++s)
+            t.slots[s].pid = -1;
+    }
+    seatIndexInit(state);
+}
+
+// Mirrors the slot release in handleGroupFinished
+static void leave(const Seated& g) {
+    Table& t = state->tables[g.table];
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+        if (t.slots[s].pid != g.pid) continue;
+        t.occupiedSeats -= t.slots[s].size;
+        state->currentGuestCount -= t.slots[s].size;
+        t.slots[s].pid = -1;
+        t.slots[s].size = 0;
+        seatIndexUpdate(state, g.table);
+        return;
+    }
+}
+
+int main() {
+    shmId = shmget(IPC_PRIVATE, sizeof(RestaurantState) + SEM_COUNT * sizeof(FutexSem), IPC_CREAT | 0600);
+#if !FUTEX_SEMAPHORES
+    semId = semget(IPC_PRIVATE, SEM_COUNT, IPC_CREAT | 0600);
+#endif
+    if (shmId == -1 || (semId == -1 && !FUTEX_SEMAPHORES)) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    state = (RestaurantState*)shmat(shmId, NULL, 0);
+    semTable = (FutexSem*)(state + 1);
+    semSet(SEM_MUTEX_STATE, 1);
+    initTables();
+    srand(1);
+
+    static Seated seated[TABLE_COUNT * MAX_TABLE_SLOTS];
+    int seatedCount = 0;
+    long assigned = 0;
+    double assignNs = 0, occupancy = 0;
+
+    for (int r = 0; r < ROUNDS; ++r) {
+        int size = rand() % 4 + 1;
+        bool vip = rand() % 100 < 2;
+
+        double t0 = nowNs();
+        int table = assignTable(state, vip, size, r, r + 1, -1);
+        assignNs += nowNs() - t0;
+
+        if (table != -1) {
+            seated[seatedCount++] = { table, r + 1 };
+            assigned++;
+        } else if (seatedCount > 0) {
+            int k = rand() % seatedCount;
+            leave(seated[k]);
+            seated[k] = seated[--seatedCount];
+        }
+        occupancy += (double)state->currentGuestCount / TOTAL_SEATS;
+    }
+
+    printf("policy: %s, tables=%d seats=%d\n",
+        seatingPolicy.name, TABLE_COUNT, TOTAL_SEATS);
+    printf("  assignTable %.1f ns/call, %.1f%% seated, %.1f%% seats occupied on average\n",
+        assignNs / ROUNDS, 100.0 * assigned / ROUNDS, 100.0 * occupancy / ROUNDS);
+
+    shmdt(state);
+    shmctl(shmId, IPC_RMID, NULL);
+#if !FUTEX_SEMAPHORES
+    semctl(semId, 0, IPC_RMID);
+#endif
+    return 0;
+}
@@ -0,0 +1,252 @@
+﻿// Seating policy comparison: one seeded stream of group arrivals (sizes,
+// VIP share and dish counts drawn like client.h) is replayed in virtual time
+// through every policy in seatingPolicies, using the same seatFindTable()
+// and seatPickQueued() calls as the service. Arrivals seat at once only if
+// their queue is empty (the service's fairness rule); a seating pass over
+// all tables follows every arrival and departure. Reports throughput in
+// groups per virtual second, p50/p99/max time to table, VIP p99, seat
+// utilization and the real time spent in policy code per group. Build with
+// MODE_FLAGS=-DVIP_AGING=0 to compare against VIPs always going first.
+// Usage: bench/seating_replay_bench [load] [groups], load = offered seat
+// demand as a share of all seats (default 0.95).
+#include "seating.h"
+#include <algorithm>
+#include <math.h>
+#include <queue>
+#include <vector>
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const double MS_PER_DISH = 100.0; // Virtual dining time per dish
+
+struct Arrival {
+    double atMs;
+    int size;
+    bool vip;
+    double diningMs;
+};
+
+struct Departure {
+    double atMs;
+    int table;
+    pid_t pid;
+    bool operator>(const Departure& o) const { return atMs > o.atMs; }
+};
+
+struct Result {
+    double groupsPerSec;
+    double p50Ms, p99Ms, maxMs, vipP99Ms;
+    double utilization;
+    double policyNs;
+};
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double uniform() {
+    return (rand() + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+static std::vector<Arrival> makeStream(int groups, double load) {
+    // Mean seat time per group: 2.5 seats x 6.5 dishes
+    double meanSeatMs = 2.5 * 6.5 * MS_PER_DISH;
+    double gapMs = meanSeatMs / (TOTAL_SEATS * load);
+
+    std::vector<Arrival> stream(groups);
+    double t = 0;
+    for (Arrival& a : stream) {
+        t += -gapMs * log(uniform());
+        a.atMs = t;
+        a.size = rand() % MAX_GROUP_SIZE + 1;
+        a.vip = (rand() % 100) < 2;
+        a.diningMs = (rand() % 8 + 3) * MS_PER_DISH;
+    }
+    return stream;
+}
+
+static void initState() {
+    memset((void*)state, 0, sizeof(RestaurantState));
+    for (int i = 0; i < TABLE_COUNT; ++i) {
+        Table& t = state->tables[i];
+        t.tableID = i;
+        t.capacity = i < X1 ? 1 : i < X1 + X2 ? 2 : i < X1 + X2 + X3 ? 3 : 4;
+        for (int s = 0; s < MAX_TABLE_SLOTS; ++s)
+            t.slots[s].pid = -1;
+    }
+    seatIndexInit(state);
+    queueInit(state->vipQueue);
+    queueInit(state->normalQueue);
+}
+
+// Mirrors seatGroup and the slot release in handleGroupFinished
+static void occupy(int table, pid_t pid, int size, bool vip) {
+    Table& t = state->tables[table];
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+        if (t.slots[s].pid != -1) continue;
+        t.slots[s].pid = pid;
+        t.slots[s].size = size;
+        t.slots[s].vipStatus = vip;
+        t.occupiedSeats += size;
+        state->currentGuestCount += size;
+        seatIndexUpdate(state, table);
+        return;
+    }
+}
+
+static void release(int table, pid_t pid) {
+    Table& t = state->tables[table];
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+        if (t.slots[s].pid != pid) continue;
+        t.occupiedSeats -= t.slots[s].size;
+        state->currentGuestCount -= t.slots[s].size;
+        t.slots[s].pid = -1;
+        t.slots[s].size = 0;
+        seatIndexUpdate(state, table);
+        return;
+    }
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    size_t k = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static Result replay(const std::vector<Arrival>& stream) {
+    int groups = (int)stream.size();
+    std::vector<double> waits, vipWaits;
+    std::priority_queue<Departure, std::vector<Departure>, std::greater<Departure>> leaving;
+    double policyNs = 0, seatMs = 0, clockMs = 0;
+    int next = 0, seatedCount = 0, checks = 0;
+
+    initState();
+
+    auto seat = [&](int gid, int table, double atMs) {
+        const Arrival& a = stream[gid];
+        occupy(table, gid + 1, a.size, a.vip);
+        leaving.push({ atMs + a.diningMs, table, gid + 1 });
+        waits.push_back(atMs - a.atMs);
+        if (a.vip) vipWaits.push_back(atMs - a.atMs);
+        seatedCount++;
+    };
+
+    while (seatedCount < groups || !leaving.empty()) {
+        // A full queue keeps later arrivals at the door, like the client
+        // admission throttle; they are retried after the next departure
+        bool door = false;
+        if (next < groups) {
+            const GroupQueue& q = stream[next].vip ? state->vipQueue : state->normalQueue;
+            door = q.freeHead == -1 && !leaving.empty();
+        }
+        bool arrive = next < groups && !door && (leaving.empty() || stream[next].atMs <= leaving.top().atMs);
+
+        double atMs = arrive ? std::max(stream[next].atMs, clockMs) : leaving.top().atMs;
+        seatMs += state->currentGuestCount * (atMs - clockMs);
+        clockMs = atMs;
+
+        double t0 = nowNs();
+        if (arrive) {
+            const Arrival& a = stream[next];
+            const GroupQueue& q = a.vip ? state->vipQueue : state->normalQueue;
+            int table = q.count == 0 ? seatFindTable(state, a.vip, a.size) : -1;
+            policyNs += nowNs() - t0;
+
+            long long expiry;
+            if (table != -1) {
+                seat(next, table, atMs);
+            } else if (queuePush(next + 1, a.vip, a.size, next, -1, 0, expiry)) {
+                // Queue on the virtual clock
+                GroupQueue& q = a.vip ? state->vipQueue : state->normalQueue;
+                q.queuedNs[q.tail[a.size]] = (long long)(a.atMs * 1e6);
+            } else {
+                fprintf(stderr, "queue full at group %d\n", next);
+                exit(EXIT_FAILURE);
+            }
+            next++;
+        } else {
+            Departure d = leaving.top();
+            leaving.pop();
+            release(d.table, d.pid);
+            policyNs += nowNs() - t0;
+        }
+
+        // Seating pass over every table, as with INCREMENTAL_SEATING=0
+        SeatPick picks[MAX_TABLE_SLOTS];
+        for (bool seated = true; seated;) {
+            seated = false;
+            for (int table = seatingPolicy.fit == SEAT_FIT_PACK ? 0 : -1; table < TABLE_COUNT; ++table) {
+                t0 = nowNs();
+                int n = seatPickQueued(state, table, true, (long long)(atMs * 1e6), picks, checks);
+                for (int j = 0; j < n; ++j) {
+                    GroupQueue& q = picks[j].vip ? state->vipQueue : state->normalQueue;
+                    int gid = q.groupID[picks[j].node];
+                    queueRemove(q, picks[j].node);
+                    policyNs += nowNs() - t0;
+                    seat(gid, picks[j].table, atMs);
+                    t0 = nowNs();
+                }
+                policyNs += nowNs() - t0;
+                if (n > 0) seated = true;
+                if (seatingPolicy.fit != SEAT_FIT_PACK) break;
+            }
+        }
+    }
+
+    Result r;
+    r.groupsPerSec = groups / (clockMs / 1000.0);
+    r.p50Ms = percentile(waits, 0.50);
+    r.p99Ms = percentile(waits, 0.99);
+    r.maxMs = percentile(waits, 1.0);
+    r.vipP99Ms = percentile(vipWaits, 0.99);
+    r.utilization = seatMs / (clockMs * TOTAL_SEATS);
+    r.policyNs = policyNs / groups;
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    double load = argc > 1 ? atof(argv[1]) : 0.95;
+    int groups = argc > 2 ? atoi(argv[2]) : 20000;
+    if (load <= 0 || groups <= 0) {
+        fprintf(stderr, "usage: %s [load] [groups]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    shmId = shmget(IPC_PRIVATE, sizeof(RestaurantState) + SEM_COUNT * sizeof(FutexSem), IPC_CREAT | 0600);
+#if !FUTEX_SEMAPHORES
+    semId = semget(IPC_PRIVATE, SEM_COUNT, IPC_CREAT | 0600);
+#endif
+    if (shmId == -1 || (semId == -1 && !FUTEX_SEMAPHORES)) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    state = (RestaurantState*)shmat(shmId, NULL, 0);
+    semTable = (FutexSem*)(state + 1);
+    semSet(SEM_MUTEX_QUEUE, 1);
+
+    srand(1);
+    std::vector<Arrival> stream = makeStream(groups, load);
+
+    printf("%d groups, offered load %.0f%% of %d seats, tables=%d\n",
+        groups, 100 * load, TOTAL_SEATS, TABLE_COUNT);
+    printf("%-12s %10s %9s %9s %9s %11s %7s %10s\n",
+        "policy", "groups/s", "p50 ms", "p99 ms", "max ms", "VIP p99 ms", "util", "ns/group");
+    for (int p = 0; p < seatingPolicyCount; ++p) {
+        seatingPolicy = seatingPolicies[p];
+        Result r = replay(stream);
+        printf("%-12s %10.1f %9.1f %9.1f %9.1f %11.1f %6.1f%% %10.0f\n",
+            seatingPolicy.name, r.groupsPerSec, r.p50Ms, r.p99Ms, r.maxMs, r.vipP99Ms,
+            100 * r.utilization, r.policyNs);
+    }
+
+    shmdt(state);
+    shmctl(shmId, IPC_RMID, NULL);
+#if !FUTEX_SEMAPHORES
+    semctl(semId, 0, IPC_RMID);
+#endif
+    return 0;
+}
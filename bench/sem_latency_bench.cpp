@@ -0,0 +1,86 @@
+﻿// Lock round-trip latency: P()/V() as built (FUTEX_SEMAPHORES) against raw
+// SysV semop, both uncontended (one process) and handed off between two
+// processes (ping-pong, every operation has a waiter to wake).
+#include "ipc_manager.h"
+
+volatile sig_atomic_t terminate_flag = 0;
+volatile sig_atomic_t evacuate_flag = 0;
+
+static const int ROUNDS = 1000000;
+static const int PINGS = 50000;
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int sysvSet = -1;
+
+static void sysvP(int semnum) {
+    struct sembuf op = { (unsigned short)semnum, -1, 0 };
+    struct timespec ts = { 0, 500000000 };
+    while (semtimedop(sysvSet, &op, 1, &ts) == -1) {}
+}
+
+static void sysvV(int semnum) {
+    struct sembuf op = { (unsigned short)semnum, 1, 0 };
+    semop(sysvSet, &op, 1);
+}
+
+typedef void (*SemOp)(int);
+
+static double uncontended(SemOp p, SemOp v) {
+    double t0 = nowNs();
+    for (int i = 0; i < ROUNDS; ++i) {
+        p(0);
+        v(0);
+    }
+    return (nowNs() - t0) / ROUNDS;
+}
+
+// Semaphores 1 and 2 start at 0; each side waits for the other's signal
+static double pingPong(SemOp p, SemOp v) {
+    double t0 = nowNs();
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (int i = 0; i < PINGS; ++i) {
+            p(1);
+            v(2);
+        }
+        _exit(0);
+    }
+    for (int i = 0; i < PINGS; ++i) {
+        v(1);
+        p(2);
+    }
+    waitpid(pid, NULL, 0);
+    return (nowNs() - t0) / PINGS;
+}
+
+int main() {
+    shmId = shmget(IPC_PRIVATE, 3 * sizeof(FutexSem), IPC_CREAT | 0600);
+    sysvSet = semget(IPC_PRIVATE, 3, IPC_CREAT | 0600);
+    if (shmId == -1 || sysvSet == -1) {
+        perror("bench ipc");
+        return EXIT_FAILURE;
+    }
+    semTable = (FutexSem*)shmat(shmId, NULL, 0);
+    semId = sysvSet;
+
+    semctl(sysvSet, 0, SETVAL, 1);
+    semSet(0, 1);
+    semSet(1, 0);
+    semSet(2, 0);
+
+    printf("backend: %s, cpus=%ld\n", FUTEX_SEMAPHORES ? "futex" : "sysv", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  uncontended P+V: sysv %.1f ns  P()/V() %.1f ns\n",
+        uncontended(sysvP, sysvV), uncontended(P, V));
+    printf("  ping-pong round trip: sysv %.1f ns  P()/V() %.1f ns\n",
+        pingPong(sysvP, sysvV), pingPong(P, V));
+
+    shmdt(semTable);
+    shmctl(shmId, IPC_RMID, NULL);
+    semctl(sysvSet, 0, IPC_RMID);
+    return 0;
+}
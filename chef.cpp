@@ -1,8 +1,9 @@
 ﻿#include "chef.h"
+#include "belt.h"
 
 // Places a dish on the conveyor belt
 // dish=-1 for random dish, or specific ID for premium orders
-void chefPutDish(RestaurantState* state, int dish, int target) {
+void chefPutDish(RestaurantState* state, int dish, int target, int table) {
     int idx = dish > 2 ? dish : rand() % 3;
 
     Dish plate;
@@ -10,27 +11,27 @@ void chefPutDish(RestaurantState* state, int dish, int target) {
     plate.price = priceForColor(plate.color);
     plate.targetGroupID = target;
 
+#if !BELT_LOCKFREE
     // Wait for free slot on belt
     P(SEM_BELT_SLOTS);
-    P(SEM_MUTEX_BELT);
+#endif
 
-    int slotIdx = -1;
-    for (int i = 0; i < BELT_SIZE; ++i) {
-        if (state->belt[i].dishID == 0) {
-            slotIdx = i;
-            break;
-        }
-    }
+#if !PREMIUM_ROUTING
+    table = -1;
+#endif
 
-    if (slotIdx != -1) {
-        plate.dishID = state->nextDishID++;
-        state->belt[slotIdx] = plate;
+    // Locks only the belt segment that receives the dish
+    // (lock-free mode: waits for a reservation and publishes with one CAS)
+    int slotIdx = beltPlaceDish(state, plate, 0, table);
 
+    if (slotIdx != -1) {
         int colorIdx = colorToIndex(plate.color);
         state->producedCount[colorIdx]++;
         state->producedValue[colorIdx] += plate.price;
 
+#if !BELT_LOCKFREE
         V(SEM_BELT_ITEMS); // Notify consumers
+#endif
 
         char buffer[128];
         snprintf(buffer, sizeof(buffer),
@@ -40,7 +41,9 @@ void chefPutDish(RestaurantState* state, int dish, int target) {
 
     } else {
         // Should not happen if semaphore logic is correct
+#if !BELT_LOCKFREE
         V(SEM_BELT_SLOTS);
+#endif
 #if STRESS_TEST
         char logBuf[128];
         snprintf(logBuf, sizeof(logBuf), "\033[31m[%ld] [CHEF]: BELT FULL (STRESS TEST) - STOPPING\033[0m", time(NULL));
@@ -48,8 +51,6 @@ void chefPutDish(RestaurantState* state, int dish, int target) {
         while(!terminate_flag && !evacuate_flag) sleep(1);
 #endif
     }
-
-    V(SEM_MUTEX_BELT);
 }
 
 // Determines sleep time multiplier based on simulation speed
@@ -85,10 +86,7 @@ void startChef() {
     while (!terminate_flag && !evacuate_flag) {
 #if STRESS_TEST
         // In Stress Test, stop if belt is full
-        P(SEM_MUTEX_BELT);
-        int items = 0;
-        for(int i=0; i<BELT_SIZE; ++i) if(state->belt[i].dishID != 0) items++;
-        V(SEM_MUTEX_BELT);
+        int items = beltItems(state);
         
         if (items >= BELT_SIZE) {
              char logBuf[128];
@@ -103,16 +101,16 @@ void startChef() {
 
         // Check for premium orders first (Highest priority)
         if (queueRecvRequest(order)) {
-            chefPutDish(state, order.dish, order.groupID);
+            chefPutDish(state, order.dish, order.groupID, order.tableIndex);
             premiumCookedCount++;
         } else {
             // Cook normal dish
 #if PREDEFINED_ZOMBIE_TEST
             if (premiumCookedCount >= 100) {
-                chefPutDish(state, -1, -1);
+                chefPutDish(state, -1, -1, -1);
             }
 #else
-            chefPutDish(state, -1, -1);
+            chefPutDish(state, -1, -1, -1);
 #endif
         }
 
@@ -5,4 +5,5 @@
 void startChef();
 
 // Core cooking logic (places dish on belt)
-void chefPutDish(RestaurantState* state, int dish, int target);
+// table is the target group's table for premium routing, or -1
+void chefPutDish(RestaurantState* state, int dish, int target, int table);
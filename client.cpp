@@ -1,5 +1,9 @@
 ﻿#include "ipc_manager.h"
 #include "client.h"
+#include "belt.h"
+#include "fiber.h"
+
+#include <sys/resource.h>
 
 #include <semaphore.h>
 #define ASSIGN 1
@@ -17,6 +21,28 @@ static void groupSignalHandler(int sig) {
 
 int Group::nextGroupID = 0;
 
+// Sends a premium order for the group's table and remembers when it left
+static void sendPremiumOrder(Group& g, PremiumRequest& order) {
+    order.tableIndex = g.getTableIndex();
+    g.recordPremiumOrder(monotonicNs());
+    __atomic_fetch_add(&state->premiumOrdered, 1, __ATOMIC_RELAXED);
+    queueSendRequest(order);
+}
+
+// Accounts a targeted dish eaten by its group against the oldest open order
+static void recordPremiumDelivery(Group& g) {
+    long long sentNs;
+    if (!g.takePremiumOrder(sentNs))
+        return;
+
+    long long ns = monotonicNs() - sentNs;
+    __atomic_fetch_add(&state->premiumDelivered, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state->premiumDeliveryNs, ns, __ATOMIC_RELAXED);
+
+    long long maxNs = __atomic_load_n(&state->premiumDeliveryMaxNs, __ATOMIC_RELAXED);
+    while (ns > maxNs && !__atomic_compare_exchange_n(&state->premiumDeliveryMaxNs, &maxNs, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
 // Async thread to reap child processes (prevents zombies)
 // Uses semaphore to wake up only when needed (Event-driven)
 static void* reaperThread(void* arg) {
@@ -28,9 +54,16 @@ static void* reaperThread(void* arg) {
         }
 
         int status;
-        // Wait for any child process to change state
-        pid_t pid = waitpid(-1, &status, 0);
+        // Wait for any child process to change state; an interrupted wait is
+        // retried, as going back to sem_wait would lose this child's token
+        pid_t pid;
+        do {
+            pid = waitpid(-1, &status, 0);
+        } while (pid == -1 && errno == EINTR);
         
+        if (pid > 0)
+            __atomic_sub_fetch(&state->groupProcs, 1, __ATOMIC_RELAXED);
+
         if (pid == -1) {
             if (errno == ECHILD) {
                 if (terminate_flag || evacuate_flag) {
@@ -38,9 +71,6 @@ static void* reaperThread(void* arg) {
                 }
                 continue;
             }
-            if (errno == EINTR) {
-                continue;
-            }
         }
     }
     return nullptr;
@@ -57,18 +87,19 @@ static bool isClosingTime() {
     return (elapsed - pauseSec) >= SIMULATION_DURATION_SECONDS;
 }
 
-// Creates a new group process (fork)
-static bool handleCreateGroup() {
-    if (isClosingTime() || terminate_flag || evacuate_flag) {
-        return false;
-    }
+// Raises a shared peak counter to v (atomic ops)
+static void notePeak(int* peak, int v) {
+    int cur = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (v > cur && !__atomic_compare_exchange_n(peak, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
 
+// Forks a group or worker process running body(arg), then exits it
+static bool forkChild(void (*body)(void*), void* arg) {
     sigset_t blockSet, oldSet;
     sigemptyset(&blockSet);
     sigaddset(&blockSet, SIGTERM);
     sigprocmask(SIG_BLOCK, &blockSet, &oldSet);
 
-    Group g;
     pid_t pid = fork();
     if (CHECK_ERR(pid, ERR_IPC_INIT, "fork group failed") != ERR_DECISION_IGNORE) {
         sigprocmask(SIG_SETMASK, &oldSet, NULL);
@@ -88,12 +119,133 @@ static bool handleCreateGroup() {
         
         sigprocmask(SIG_SETMASK, &oldSet, NULL);
 
-        groupLoop(g);
+        clientQid = connectQueue(CLIENT_REQ_QUEUE);
+        serviceQid = connectQueue(SERVICE_REQ_QUEUE);
+        premiumQid = connectQueue(PREMIUM_REQ_QUEUE);
+
+        body(arg);
         _exit(0);
     }
     
     // Parent Process
     sigprocmask(SIG_SETMASK, &oldSet, NULL);
+    notePeak(&state->groupProcsPeak, __atomic_add_fetch(&state->groupProcs, 1, __ATOMIC_RELAXED));
+
+    // Notify reaper that a new child exists
+    if (parent) { 
+        sem_post(&reaperSem);
+    }
+
+    return true;
+}
+
+// Runs a group and drops it from the live count
+static void runGroup(Group& g) {
+    groupLoop(g);
+    __atomic_sub_fetch(&state->groupsLive, 1, __ATOMIC_RELAXED);
+}
+
+#if GROUP_WORKERS > 0
+static const size_t GROUP_THREAD_STACK = 256 * 1024;
+static int workerGroups = 0; // Groups running in this worker (atomic ops)
+
+static void* groupThread(void* arg) {
+    Group* g = (Group*)arg;
+    runGroup(*g);
+    delete g;
+    __atomic_sub_fetch(&workerGroups, 1, __ATOMIC_RELEASE);
+    return nullptr;
+}
+
+// Pool worker: starts a thread per handed-off group until shutdown, then
+// waits for its groups to wind down
+static void workerLoop(void*) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, GROUP_THREAD_STACK);
+
+    GroupHandoff& h = state->handoff;
+    while (!terminate_flag && !evacuate_flag) {
+        P(SEM_HANDOFF_ITEMS);
+        if (terminate_flag || evacuate_flag) break;
+
+        P(SEM_MUTEX_HANDOFF);
+        GroupSpec spec = h.spec[h.head % GROUP_HANDOFF_SIZE];
+        h.head++;
+        V(SEM_MUTEX_HANDOFF);
+        V(SEM_HANDOFF_FREE);
+
+        Group* g = new Group(spec);
+        __atomic_add_fetch(&workerGroups, 1, __ATOMIC_RELAXED);
+
+        pthread_t t;
+        int rc = pthread_create(&t, &attr, groupThread, g);
+        if (rc != 0) {
+            handleError(ERR_IPC_INIT, "group thread create failed", rc);
+            __atomic_sub_fetch(&workerGroups, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&state->groupsLive, 1, __ATOMIC_RELAXED);
+            delete g;
+        }
+    }
+
+    while (__atomic_load_n(&workerGroups, __ATOMIC_ACQUIRE) > 0)
+        usleep(1000);
+    pthread_attr_destroy(&attr);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    __atomic_fetch_add(&state->groupRssKb, ru.ru_maxrss, __ATOMIC_RELAXED);
+}
+
+// Queues a group for the pool; false on shutdown
+static bool handOffGroup(const Group& g) {
+    P(SEM_HANDOFF_FREE);
+    if (terminate_flag || evacuate_flag) return false;
+
+    GroupHandoff& h = state->handoff;
+    h.spec[h.tail % GROUP_HANDOFF_SIZE] = g.getSpec();
+    h.tail++;
+    V(SEM_HANDOFF_ITEMS);
+    return true;
+}
+#else
+static void groupProcess(void* arg) {
+    Group& g = *(Group*)arg;
+    g.setPid(getpid());
+    runGroup(g);
+
+    if (g.getTableIndex() != -1) {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        __atomic_fetch_add(&state->groupRssKb, ru.ru_maxrss, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&state->groupRssGuests, g.getGroupSize(), __ATOMIC_RELAXED);
+    }
+}
+#endif
+
+// Creates a new group: a process of its own, or a spec handed to the pool
+static bool handleCreateGroup() {
+    if (isClosingTime() || terminate_flag || evacuate_flag) {
+        return false;
+    }
+
+    Group g;
+    notePeak(&state->groupsLivePeak, __atomic_add_fetch(&state->groupsLive, 1, __ATOMIC_RELAXED));
+#if GROUP_WORKERS > 0
+    bool started = handOffGroup(g);
+#else
+    bool started = forkChild(groupProcess, &g);
+#endif
+    if (!started) {
+        __atomic_sub_fetch(&state->groupsLive, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    long long now = monotonicNs();
+    if (state->groupCreateFirstNs == 0)
+        state->groupCreateFirstNs = now;
+    state->groupCreateLastNs = now;
 
     RestaurantState* s = getState();
     if (s) {
@@ -101,11 +253,6 @@ static bool handleCreateGroup() {
         s->totalGroupsCreated++;
         V(SEM_MUTEX_STATE);
     }
-    
-    // Notify reaper that a new child exists
-    if (parent) { 
-        sem_post(&reaperSem);
-    }
 
     return true;
 }
@@ -115,17 +262,21 @@ void handleGroupFinished(Group& g, bool wasSeated) {
     char buf[256];
     snprintf(buf, sizeof(buf),
         "\033[38;5;118m[%ld] [CLIENTS]: GROUP FINISHED    | groupID=%d pid=%d wasSeated=%d\033[0m",
-        time(NULL), g.getGroupID(), getpid(), wasSeated);
+        time(NULL), g.getGroupID(), g.getPid(), wasSeated);
     fifoLog(buf);
 
-    if (!wasSeated)
+    // A seated group's entry still records its seat; the service frees it
+    if (!wasSeated) {
+        groupMailboxClose(g.getMailbox());
         return;
+    }
 
     ClientRequest req{};
     req.mtype = FINISHED;
     req.type = REQ_GROUP_FINISHED;
-    req.pid = getpid();
+    req.pid = g.getPid();
     req.groupID = g.getGroupID();
+    req.mailbox = g.getMailbox();
     g.getEatenCount(req.eatenCount);
     queueSendRequest(req);
 }
@@ -133,8 +284,8 @@ void handleGroupFinished(Group& g, bool wasSeated) {
 static void handleGetGroup(Group& g) {
     ClientResponse resp{};
 
-    resp.mtype = getpid();
-    resp.pid = getpid();
+    resp.mtype = g.getPid();
+    resp.pid = g.getPid();
     resp.groupID = g.getGroupID();
     resp.groupSize = g.getGroupSize();
     resp.adultCount = g.getAdultCount();
@@ -151,115 +302,236 @@ static void handleRejectGroup(Group& g) {
 
     snprintf(logBuffer, sizeof(logBuffer),
         "\033[38;5;118m[%ld] [CLIENTS]: GROUP REJECTED pid=%d groupID=%d size=%d vip=%d dishes=%d\033[0m",
-        time(NULL), getpid(), g.getGroupID(), g.getGroupSize(), g.getVipStatus(), g.getDishesToEat()
+        time(NULL), g.getPid(), g.getGroupID(), g.getGroupSize(), g.getVipStatus(), g.getDishesToEat()
     );
     fifoLog(logBuffer);
 
     handleGroupFinished(g, false);
-    _exit(0);
 }
 
 void handleTableAssigned(Group& g, int tableIndex) {
     g.setTableIndex(tableIndex);
 }
 
-// Logic to find and consume a dish from the conveyor belt
-void handleConsumeDish(Group& g) {
-    if (evacuate_flag || terminate_flag)
-        return;
+// Snapshot of the table's window event, taken before scanning the window
+static int windowSeq(int tableIndex) {
+    return __atomic_load_n(&state->windowDish[tableIndex].seq, __ATOMIC_SEQ_CST);
+}
+
+// Sleeps until a dish enters the window after the snapshot (DISH_NOTIFY),
+// else lets the chef and the belt run first
+static void waitForWindow(int tableIndex, int seen) {
+#if DISH_NOTIFY
+    fiberWaitEvent(&state->windowDish[tableIndex], seen);
+#else
+    fiberYield();
+#endif
+}
 
+// One pass over the group's table window, taking up to max dishes the group
+// may eat. Returns how many, with their logical belt slots. Without wait it
+// never suspends the caller and finds nothing when no belt item is free
+static int takeFromWindow(Group& g, int max, Dish out[], int slots[], bool wait) {
     int groupID = g.getGroupID();
-    int dishID = 0;
-    int beltSlot = -1;
-    colors color;
-    int price = 0;
+    int slotsPerTable = BELT_WINDOW_SLOTS;
+    int startSlot = beltWindowStart(g.getTableIndex());
+    int taken = 0;
+
+#if BELT_LOCKFREE
+    (void)wait;
+    __atomic_fetch_add(&state->beltWindowScans, 1, __ATOMIC_RELAXED);
+
+    // Lock-free mode: no semaphore on the eat path, one CAS claims each dish
+    int physicalStart = beltPhysicalSlot(state, startSlot);
+    while (taken < max) {
+        Dish d;
+        int physical = beltClaimForGroup(state, physicalStart, slotsPerTable, groupID, d);
+        if (physical == -1)
+            break;
 
-    if (evacuate_flag || terminate_flag)
-        return;
+        // Another person of the group may have eaten the last dish meanwhile
+        if (!g.consumeOneDish(d.color)) {
+            beltReturnClaim(state, physical, d);
+            break;
+        }
+
+        out[taken] = d;
+        slots[taken] = beltLogicalSlot(state, physical);
+        taken++;
+
+        beltReleaseClaim(state);
 
+        int colorIdx = colorToIndex(d.color);
+        __atomic_fetch_add(&state->soldCount[colorIdx], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&state->soldValue[colorIdx], d.price, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&state->revenue, d.price, __ATOMIC_RELAXED);
+    }
+#else
     // Check availability of items on belt (Semaphore check)
-    P(SEM_BELT_ITEMS);
-    if (evacuate_flag || terminate_flag) {
-        V(SEM_BELT_ITEMS);
-        return;
+    if (!wait) {
+        if (!tryP(SEM_BELT_ITEMS))
+            return 0;
+    } else {
+        fiberP(SEM_BELT_ITEMS);
+        if (evacuate_flag || terminate_flag) {
+            V(SEM_BELT_ITEMS);
+            return 0;
+        }
     }
+    __atomic_fetch_add(&state->beltWindowScans, 1, __ATOMIC_RELAXED);
 
-    P(SEM_MUTEX_BELT);
+    // Calculate accessible slots based on table assignment; the window is
+    // pinned to its physical slots at this offset, a rotation meanwhile
+    // only makes the view one step stale
+    int windowStart = beltPhysicalSlot(state, startSlot);
+    int segments[2];
 
-    // Calculate accessible slots based on table assignment
-    int tableIndex = g.getTableIndex();
-    int slotsPerTable = BELT_SIZE / TABLE_COUNT;
-    if (slotsPerTable < 1) slotsPerTable = 1;
-    int startSlot = (tableIndex * slotsPerTable) % BELT_SIZE;
-
-    // Scan belt slots visible to this table
-    for (int j = 0; j < slotsPerTable; ++j) {
-        int i = (startSlot + j) % BELT_SIZE;
-        Dish& d = state->belt[i];
-        if (d.dishID != 0 && (d.targetGroupID == -1 || d.targetGroupID == groupID)) {
-            // Attempt to consume
-            if (!g.consumeOneDish(d.color)) {
-                // Determine if we should skip or take
-                V(SEM_BELT_ITEMS);
-                V(SEM_MUTEX_BELT);
-                return; 
-            }
+    beltLockWindow(windowStart, slotsPerTable, segments);
 
-            // Take the dish
-            dishID = d.dishID;
-            beltSlot = i;
-            color = d.color;
-            price = d.price;
+    // The P above covers the first dish, further ones take a token only if
+    // one is free
+    bool token = true;
+    while (taken < max) {
+        if (!token && !tryP(SEM_BELT_ITEMS))
+            break;
+        token = true;
 
-            d.dishID = 0;
-            d.targetGroupID = -1;
+        // Find the first dish visible to this table (vectorized window match)
+        int physical = beltFindForGroup(state, windowStart, slotsPerTable, groupID);
+        if (physical == -1)
+            break;
 
-#if CRITICAL_TEST
-            if (!state->suicideTriggered && state->soldCount[0] > 10) { 
-                state->suicideTriggered = 1;
-                fifoLog("!!! TRIGGERING SUICIDE SIGNAL IN CRITICAL SECTION !!!");
-                kill(0, SIGINT);
-                usleep(200000);
-            }
-#endif
-            // Update stats
-            int colorIdx = colorToIndex(color);
-            state->soldCount[colorIdx]++;
-            state->soldValue[colorIdx] += price;
-            state->revenue += price;
-            
-            V(SEM_BELT_SLOTS); // Slot is now free
+        // Another person of the group may have eaten the last dish meanwhile
+        Dish d = beltGet(state, physical);
+        if (!g.consumeOneDish(d.color))
             break;
+
+        // Take the dish
+        out[taken] = d;
+        slots[taken] = beltLogicalSlot(state, physical);
+        taken++;
+        token = false;
+
+        beltTake(state, physical);
+
+#if CRITICAL_TEST
+        if (!state->suicideTriggered && state->soldCount[0] > 10) { 
+            state->suicideTriggered = 1;
+            fifoLog("!!! TRIGGERING SUICIDE SIGNAL IN CRITICAL SECTION !!!");
+            kill(0, SIGINT);
+            usleep(200000);
         }
+#endif
+        // Update stats (other segments update them concurrently)
+        int colorIdx = colorToIndex(d.color);
+        __atomic_fetch_add(&state->soldCount[colorIdx], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&state->soldValue[colorIdx], d.price, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&state->revenue, d.price, __ATOMIC_RELAXED);
+        
+        V(SEM_BELT_SLOTS); // Slot is now free
     }
 
-    // If no dish was taken, restore item count semaphore
-    if (dishID == 0) {
+    // If the last token took no dish, restore item count semaphore
+    if (token) {
         V(SEM_BELT_ITEMS);
     }
 
-    V(SEM_MUTEX_BELT);
-
-    if (dishID != 0) {
-        char logBuffer[256];
-        snprintf(
-            logBuffer,
-            sizeof(logBuffer),
-            "\033[38;5;118m[%ld] [CLIENTS]: CONSUMED DISH %d | beltSlot=%d tableID=%d groupID=%d pid=%d color=%s price=%d dishesToEat=%d\033[0m",
-            time(NULL),
-            dishID,
-            beltSlot,
-            tableIndex,
-            groupID,
-            getpid(),
-            colorToString(color),
-            price,
-            g.getDishesToEat()
-        );
-        fifoLog(logBuffer);
+    beltUnlockWindow(segments);
+#endif
+
+    if (taken == 0)
+        __atomic_fetch_add(&state->beltScansWasted, 1, __ATOMIC_RELAXED);
+    return taken;
+}
+
+#if GROUP_SCANNER
+// The group's queue ran dry: one person at a time scans the window and
+// claims a dish for each person, the others eat from the queue. A window
+// version that a scan found empty is not scanned again by the rest
+static void scanForGroup(Group& g, int tableIndex) {
+    int seen = windowSeq(tableIndex);
+    int scanSeen = g.scanSeq();
+
+    if (DISH_NOTIFY && g.scannedEmpty(seen)) {
+        waitForWindow(tableIndex, seen);
+        return;
+    }
+
+    // A scan never suspends (it only tries for a belt item), so only people
+    // on threads of their own can find one running
+    if (!g.beginScan()) {
+        fiberWaitEvent(g.scanEvent(), scanSeen, true);
+        return;
     }
+
+    Dish dishes[MAX_GROUP_SIZE];
+    int slots[MAX_GROUP_SIZE];
+    int want = g.getDishesToEat();
+    if (want > g.getGroupSize())
+        want = g.getGroupSize();
+
+    int taken = want > 0 ? takeFromWindow(g, want, dishes, slots, false) : 0;
+    bool empty = want > 0 && taken == 0;
+    g.endScan(dishes, slots, taken, empty ? seen : -1);
+
+    if (empty)
+        waitForWindow(tableIndex, seen);
 }
+#endif
 
+// Logic to find and consume a dish from the conveyor belt
+void handleConsumeDish(Group& g) {
+    if (evacuate_flag || terminate_flag)
+        return;
+
+    int tableIndex = g.getTableIndex();
+    Dish d;
+    int beltSlot = -1;
+
+#if GROUP_SCANNER
+    if (!g.popClaimed(d, beltSlot)) {
+        scanForGroup(g, tableIndex);
+        if (!g.popClaimed(d, beltSlot))
+            return;
+    }
+#else
+    int seen = windowSeq(tableIndex);
+    if (takeFromWindow(g, 1, &d, &beltSlot, true) == 0) {
+        if (!g.isFinished())
+            waitForWindow(tableIndex, seen);
+        return;
+    }
+#endif
+
+    if (d.targetGroupID == g.getGroupID())
+        recordPremiumDelivery(g);
+
+    char logBuffer[256];
+    snprintf(
+        logBuffer,
+        sizeof(logBuffer),
+        "\033[38;5;118m[%ld] [CLIENTS]: CONSUMED DISH %d | beltSlot=%d tableID=%d groupID=%d pid=%d color=%s price=%d dishesToEat=%d\033[0m",
+        time(NULL),
+        d.dishID,
+        beltSlot,
+        tableIndex,
+        g.getGroupID(),
+        g.getPid(),
+        colorToString(d.color),
+        d.price,
+        g.getDishesToEat()
+    );
+    fifoLog(logBuffer);
+}
+
+
+// Adds the calling thread's context switches since before to the totals
+static void notePersonSwitches(const struct rusage& before) {
+    struct rusage now;
+    getrusage(RUSAGE_THREAD, &now);
+    __atomic_fetch_add(&state->personCswVoluntary, now.ru_nvcsw - before.ru_nvcsw, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state->personCswInvoluntary, now.ru_nivcsw - before.ru_nivcsw, __ATOMIC_RELAXED);
+}
 
 // Thread representing a single person in a group
 void* personThread(void* arg) {
@@ -279,7 +551,7 @@ void* personThread(void* arg) {
                 order.mtype = 1;
                 order.groupID = groupID;
                 order.dish = rand() % 3 + 3;
-                queueSendRequest(order);
+                sendPremiumOrder(g, order);
                 
                 char buf[256];
                 snprintf(buf, sizeof(buf), "\033[38;5;118m[%ld] [CLIENT] ZOMBIE ORDER | ordersLeft=%d\033[0m", time(NULL), g.getOrdersLeft());
@@ -290,12 +562,7 @@ void* personThread(void* arg) {
         RestaurantState* state = getState();
         // Wait until belt is full
         while (!terminate_flag && !evacuate_flag) {
-            int beltItems = 0;
-            P(SEM_MUTEX_BELT);
-            for(int i=0; i<BELT_SIZE; ++i) if(state->belt[i].dishID != 0) beltItems++;
-            V(SEM_MUTEX_BELT);
-            
-            if (beltItems >= BELT_SIZE) break; 
+            if (beltItems(state) >= BELT_SIZE) break; 
         }
 
         if (!terminate_flag && !evacuate_flag) {
@@ -320,7 +587,7 @@ void* personThread(void* arg) {
             order.groupID = groupID;
             order.dish = rand() % 3 + 3;
 
-            queueSendRequest(order);
+            sendPremiumOrder(g, order);
             
             char buf[256];
             snprintf(buf, sizeof(buf),
@@ -334,27 +601,39 @@ void* personThread(void* arg) {
     return nullptr;
 }
 
-// Lifecycle of a Group process
-void groupLoop(Group& g) {
-    clientQid = connectQueue(CLIENT_REQ_QUEUE);
-    serviceQid = connectQueue(SERVICE_REQ_QUEUE);
-    premiumQid = connectQueue(PREMIUM_REQ_QUEUE);
+#if PERSON_FIBERS
+static void personFiber(void* arg) {
+    personThread(arg);
+}
+#else
+static void* personMain(void* arg) {
+    struct rusage start;
+    getrusage(RUSAGE_THREAD, &start);
+    personThread(arg);
+    notePersonSwitches(start);
+    return nullptr;
+}
+#endif
 
+// Lifecycle of a Group (its own process, or a thread in a pool worker)
+void groupLoop(Group& g) {
     ClientRequest req{};
     req.mtype = ASSIGN;
     req.type = REQ_ASSIGN_GROUP;
-    req.pid = getpid();
+    req.pid = g.getPid();
     req.groupID = g.getGroupID();
     req.groupSize = g.getGroupSize();
     req.adultCount = g.getAdultCount();
     req.childCount = g.getChildCount();
     req.vipStatus = g.getVipStatus();
+    req.mailbox = -1;
+    req.patienceMs = g.getPatienceMs();
     memset(req.eatenCount, 0, sizeof(req.eatenCount));
 
     char buf[256];
     snprintf(buf, sizeof(buf),
         "\033[38;5;118m[%ld] [CLIENTS]: GROUP CREATED | groupID=%d pid=%d size=%d dishesToEat=%d ordersLeft=%d vipStatus=%d\033[0m",
-        time(NULL), g.getGroupID(), getpid(), g.getGroupSize(), g.getDishesToEat(), g.getOrdersLeft(), g.getVipStatus());
+        time(NULL), g.getGroupID(), g.getPid(), g.getGroupSize(), g.getDishesToEat(), g.getOrdersLeft(), g.getVipStatus());
     fifoLog(buf);
 
     // Admission Control (Backpressure)
@@ -368,6 +647,8 @@ void groupLoop(Group& g) {
         if (g.getVipStatus()) V(SEM_QUEUE_FREE_VIP); else V(SEM_QUEUE_FREE_NORMAL);
     }
 
+    req.mailbox = groupMailboxOpen(g.getPid(), g.getGroupID());
+    g.setMailbox(req.mailbox);
     queueSendRequest(req);
 
     bool wasSeated = false;
@@ -375,7 +656,7 @@ void groupLoop(Group& g) {
     // Wait for table assignment
     while (!terminate_flag && !evacuate_flag) {
         ServiceRequest resp{};
-        queueRecvRequest(resp, getpid());
+        groupReplyRecv(g.getMailbox(), g.getPid(), resp);
 
         if (resp.type == REQ_GROUP_ASSIGNED) {
             g.setTableIndex(resp.extraData);
@@ -383,26 +664,40 @@ void groupLoop(Group& g) {
             break;
         }
 
-        if (resp.type == REQ_GROUP_REJECT)
+        if (resp.type == REQ_GROUP_REJECT) {
             handleRejectGroup(g);
+            return;
+        }
     }
 
     if (wasSeated) {
         int n = g.getGroupSize();
-        pthread_t threads[n];
         PersonCtx ctx[n];
 
+#if PERSON_FIBERS
+        void* args[n];
         for (int i = 0; i < n; ++i) {
             ctx[i] = { &g, i };
-            pthread_create(&threads[i], nullptr, personThread, &ctx[i]);
+            args[i] = &ctx[i];
+        }
+
+        struct rusage before;
+        getrusage(RUSAGE_THREAD, &before);
+        fiberRun(n, personFiber, args, PERSON_FIBER_STACK);
+        notePersonSwitches(before);
+#else
+        pthread_t threads[n];
+        for (int i = 0; i < n; ++i) {
+            ctx[i] = { &g, i };
+            pthread_create(&threads[i], nullptr, personMain, &ctx[i]);
         }
 
         for (int i = 0; i < n; ++i)
             pthread_join(threads[i], nullptr);
+#endif
     }
 
     handleGroupFinished(g, wasSeated);
-    _exit(0);
 }
 
 // Main Client Process loop
@@ -415,6 +710,11 @@ void startClients() {
     pthread_t reaper;
     pthread_create(&reaper, nullptr, reaperThread, nullptr);
 
+#if GROUP_WORKERS > 0
+    for (int w = 0; w < GROUP_WORKERS; ++w)
+        forkChild(workerLoop, nullptr);
+#endif
+
     int createdGroups = 0;
     while (!terminate_flag && !evacuate_flag) {
         if (FIXED_GROUP_COUNT >= 0 && createdGroups >= FIXED_GROUP_COUNT) {
@@ -423,7 +723,7 @@ void startClients() {
         }
 
         // Admission throttle (Global limit)
-        if (getSemValue(SEM_CLIENT_FREE) <= 0) {
+        if (clientQueueFree() <= 0) {
             SIM_SLEEP(20000);
             continue;
         }
@@ -2,24 +2,57 @@
 #include "ipc_manager.h"
 #include "common.h"
 #include <pthread.h>
+#include <atomic>
 
 class Group {
 private:
+    pid_t pid; // Group key: process pid, or GROUP_KEY_BASE + groupID in a worker
     int groupID;
     int groupSize;
     int adultCount;
     int childCount;
     bool vipStatus;
-    int dishesToEat;
-    int tableIndex;
-    int ordersLeft;
-    int eatenCount[COLOR_COUNT];
+
+    // Counters on the people's eat/order path, lock-free: decrements only
+    // succeed while positive (CAS), so they never go below zero
+    std::atomic<int> dishesToEat;
+    std::atomic<int> tableIndex;
+    int mailbox; // Reply mailbox in the group registry, -1 if none
+    int patienceMs; // Queue wait before the group leaves, 0 = forever
+    std::atomic<int> ordersLeft;
+    std::atomic<int> eatenCount[COLOR_COUNT];
+
+    // Protects the pending order ring and the claimed dish queue
     pthread_mutex_t mutex;
 
+    // Send times of premium orders not delivered yet (FIFO ring)
+    static const int MAX_PENDING_ORDERS = 128;
+    long long pendingOrderNs[MAX_PENDING_ORDERS];
+    int pendingHead;
+    int pendingCount;
+
+    // Dishes claimed by the group's scanner, eaten by any of its people
+    // (GROUP_SCANNER, FIFO ring)
+    Dish claimed[MAX_GROUP_SIZE];
+    int claimedSlot[MAX_GROUP_SIZE];
+    int claimedHead;
+    std::atomic<int> claimedCount; // Written under mutex, read by isFinished() without it
+    bool scanning;      // A person is scanning the window for the group
+    int emptySeq;       // Window event seq the last scan took nothing at, -1 if none
+    ShmEvent scanDone;  // Bumped when a scan ends
+
+    void initClaims() {
+        claimedHead = 0;
+        claimedCount = 0;
+        scanning = false;
+        emptySeq = -1;
+        scanDone = {};
+    }
+
 public:
     static int nextGroupID;
 
-    Group() : tableIndex(-1) {
+    Group() : pid(-1), tableIndex(-1), mailbox(-1), pendingHead(0), pendingCount(0) {
         groupID = nextGroupID++;
 #if TABLE_SHARING_TEST == 1
         groupSize = rand() % 2 + 1;
@@ -28,7 +61,7 @@ public:
         else if (groupID == 1) groupSize = 1;
         else groupSize = 1;
 #else
-        groupSize = rand() % 4 + 1;
+        groupSize = rand() % MAX_GROUP_SIZE + 1;
 #endif
         vipStatus = (rand() % 100) < 2;
 
@@ -43,6 +76,7 @@ public:
 
         dishesToEat = rand() % 8 + 3;
         ordersLeft = rand() % dishesToEat;
+        patienceMs = GROUP_PATIENCE_MS > 0 ? GROUP_PATIENCE_MS / 2 + rand() % (GROUP_PATIENCE_MS + 1) : 0;
         
 #if PREDEFINED_ZOMBIE_TEST
         if (groupID == 0) {
@@ -54,7 +88,21 @@ public:
         }
 #endif
         
-        memset(eatenCount, 0, sizeof(eatenCount));
+        for (int i = 0; i < COLOR_COUNT; ++i)
+            eatenCount[i].store(0, std::memory_order_relaxed);
+        initClaims();
+        pthread_mutex_init(&mutex, nullptr);
+    }
+
+    // Rebuilds a group drawn by the clients process inside a pool worker
+    explicit Group(const GroupSpec& sp)
+        : pid(GROUP_KEY_BASE + sp.groupID), groupID(sp.groupID), groupSize(sp.groupSize),
+          adultCount(sp.adultCount), childCount(sp.childCount), vipStatus(sp.vipStatus),
+          dishesToEat(sp.dishesToEat), tableIndex(-1), mailbox(-1), patienceMs(sp.patienceMs),
+          ordersLeft(sp.ordersLeft), pendingHead(0), pendingCount(0) {
+        for (int i = 0; i < COLOR_COUNT; ++i)
+            eatenCount[i].store(0, std::memory_order_relaxed);
+        initClaims();
         pthread_mutex_init(&mutex, nullptr);
     }
 
@@ -62,43 +110,40 @@ public:
         pthread_mutex_destroy(&mutex);
     }
 
+    GroupSpec getSpec() const {
+        return { groupID, groupSize, adultCount, childCount, vipStatus, dishesToEat, ordersLeft, patienceMs };
+    }
+
+    pid_t getPid() const { return pid; }
+    void setPid(pid_t p) { pid = p; }
     int  getGroupID() const { return groupID; }
     int  getGroupSize() const { return groupSize; }
     int  getAdultCount() const { return adultCount; }
     int  getChildCount() const { return childCount; }
     bool getVipStatus() const { return vipStatus; }
+    int  getMailbox() const { return mailbox; }
+    int  getPatienceMs() const { return patienceMs; }
+    void setMailbox(int m) { mailbox = m; }
     
-    int getDishesToEat() {
-        pthread_mutex_lock(&mutex);
-        int v = dishesToEat;
-        pthread_mutex_unlock(&mutex);
-        return v;
-    }
+    int getDishesToEat() const { return dishesToEat.load(std::memory_order_relaxed); }
+    int getTableIndex() const { return tableIndex.load(std::memory_order_acquire); }
+    int getOrdersLeft() const { return ordersLeft.load(std::memory_order_relaxed); }
 
-    int getTableIndex() {
-        pthread_mutex_lock(&mutex);
-        int v = tableIndex;
-        pthread_mutex_unlock(&mutex);
-        return v;
+    void getEatenCount(int out[COLOR_COUNT]) const {
+        for (int i = 0; i < COLOR_COUNT; ++i)
+            out[i] = eatenCount[i].load(std::memory_order_relaxed);
     }
 
-    int getOrdersLeft() { 
-        pthread_mutex_lock(&mutex); 
-        int o = ordersLeft; 
-        pthread_mutex_unlock(&mutex); 
-        return o; 
-    }
+    void setTableIndex(int idx) { tableIndex.store(idx, std::memory_order_release); }
 
-    void getEatenCount(int out[COLOR_COUNT]) {
-        pthread_mutex_lock(&mutex);
-        memcpy(out, eatenCount, sizeof(eatenCount));
-        pthread_mutex_unlock(&mutex);
-    }
-
-    void setTableIndex(int idx) {
-        pthread_mutex_lock(&mutex);
-        tableIndex = idx;
-        pthread_mutex_unlock(&mutex);
+    // Decrements counter if it is still positive
+    static bool takeOne(std::atomic<int>& counter) {
+        int v = counter.load(std::memory_order_relaxed);
+        while (v > 0) {
+            if (counter.compare_exchange_weak(v, v - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
     }
 
     bool orderPremiumDish() {
@@ -111,37 +156,93 @@ public:
             orderPremium = false;
 #endif
 
+        return orderPremium && takeOne(ordersLeft);
+    }
+
+    bool consumeOneDish(colors c) {
+        if (!takeOne(dishesToEat))
+            return false;
+
+        int idx = colorToIndex(c);
+        if (idx >= 0 && idx < COLOR_COUNT)
+            eatenCount[idx].fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void recordPremiumOrder(long long sentNs) {
         pthread_mutex_lock(&mutex);
-        if (orderPremium && ordersLeft > 0) {
-            ordersLeft--;
-            pthread_mutex_unlock(&mutex);
-            return true;
+        if (pendingCount < MAX_PENDING_ORDERS) {
+            pendingOrderNs[(pendingHead + pendingCount) % MAX_PENDING_ORDERS] = sentNs;
+            pendingCount++;
         }
         pthread_mutex_unlock(&mutex);
-        return false;
     }
 
-    bool consumeOneDish(colors c) {
+    // Pops the oldest pending order; dishes are matched to orders in FIFO order
+    bool takePremiumOrder(long long& sentNs) {
         pthread_mutex_lock(&mutex);
-        if (dishesToEat <= 0) {
-            pthread_mutex_unlock(&mutex);
-            return false;
+        bool found = pendingCount > 0;
+        if (found) {
+            sentNs = pendingOrderNs[pendingHead];
+            pendingHead = (pendingHead + 1) % MAX_PENDING_ORDERS;
+            pendingCount--;
         }
+        pthread_mutex_unlock(&mutex);
+        return found;
+    }
 
-        dishesToEat--;
-        int idx = colorToIndex(c);
-        if (idx >= 0 && idx < COLOR_COUNT)
-            eatenCount[idx]++;
+    // Takes the oldest claimed dish and its logical belt slot
+    bool popClaimed(Dish& d, int& slot) {
+        pthread_mutex_lock(&mutex);
+        bool found = claimedCount > 0;
+        if (found) {
+            d = claimed[claimedHead];
+            slot = claimedSlot[claimedHead];
+            claimedHead = (claimedHead + 1) % MAX_GROUP_SIZE;
+            claimedCount--;
+        }
+        pthread_mutex_unlock(&mutex);
+        return found;
+    }
 
+    // Becomes the group's scanner, false if another person is scanning
+    bool beginScan() {
+        pthread_mutex_lock(&mutex);
+        bool ok = !scanning;
+        scanning = true;
         pthread_mutex_unlock(&mutex);
-        return true;
+        return ok;
     }
 
-    bool isFinished() {
+    // Queues the n dishes a scan claimed (at most one per person) and wakes
+    // the people waiting for it; emptySeen is the window version it found empty
+    void endScan(const Dish* d, const int* slots, int n, int emptySeen) {
         pthread_mutex_lock(&mutex);
-        bool done = (dishesToEat <= 0);
+        for (int i = 0; i < n; ++i) {
+            int at = (claimedHead + claimedCount) % MAX_GROUP_SIZE;
+            claimed[at] = d[i];
+            claimedSlot[at] = slots[i];
+            claimedCount++;
+        }
+        emptySeq = emptySeen;
+        scanning = false;
         pthread_mutex_unlock(&mutex);
-        return done;
+        eventNotify(&scanDone);
+    }
+
+    bool scannedEmpty(int seen) {
+        pthread_mutex_lock(&mutex);
+        bool empty = emptySeq == seen;
+        pthread_mutex_unlock(&mutex);
+        return empty;
+    }
+
+    int scanSeq() { return __atomic_load_n(&scanDone.seq, __ATOMIC_SEQ_CST); }
+    ShmEvent* scanEvent() { return &scanDone; }
+
+    bool isFinished() const {
+        return dishesToEat.load(std::memory_order_acquire) <= 0 &&
+               claimedCount.load(std::memory_order_acquire) == 0;
     }
 };
 
@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <string.h>
 #include <time.h>
+#include <stdint.h>
 #include <pthread.h>
 #include "error_handler.h"
 
@@ -53,7 +54,129 @@
 #define FIXED_GROUP_COUNT 1000
 
 #define MAX_QUEUE 1000
+#define MAX_GROUP_SIZE 4
 #define BELT_SIZE 100
+#define BELT_WORDS ((BELT_SIZE + 63) / 64) // 64-bit words in the belt occupancy bitmap
+
+// Belt synchronization: 0 = segment locks (SysV semaphores),
+// 1 = lock-free slots claimed with CAS (make MODE_FLAGS=-DBELT_LOCKFREE=1)
+#ifndef BELT_LOCKFREE
+#define BELT_LOCKFREE 0
+#endif
+
+#if BELT_LOCKFREE
+#include <atomic>
+#endif
+
+// Semaphore backend behind P()/V(): 1 = futex words in shared memory (no
+// syscall unless contended), 0 = SysV semaphore set (make MODE_FLAGS=-DFUTEX_SEMAPHORES=0)
+#ifndef FUTEX_SEMAPHORES
+#define FUTEX_SEMAPHORES 1
+#endif
+
+// Client->service and client->chef requests: 1 = MPSC rings in shared memory,
+// 0 = SysV message queues (make MODE_FLAGS=-DSHM_QUEUES=0)
+#ifndef SHM_QUEUES
+#define SHM_QUEUES 1
+#endif
+
+// Seating replies: 1 = per-group mailbox in shared memory with a targeted
+// wakeup, 0 = serviceQid filtered by mtype=pid (make MODE_FLAGS=-DGROUP_MAILBOXES=0)
+#ifndef GROUP_MAILBOXES
+#define GROUP_MAILBOXES 1
+#endif
+
+// Client requests the service handles per wakeup before one seating pass
+// (1 = a pass after every request; make MODE_FLAGS=-DSERVICE_BATCH=1)
+#ifndef SERVICE_BATCH
+#define SERVICE_BATCH 64
+#endif
+
+// Default seating policy (see seating.h); any policy can also be picked at
+// startup with ./restauracja <policy>. SEATING_FIRST_FIT walks the tables in
+// order, SEATING_INDEXED takes the best fit from the free-capacity index,
+// SEATING_BIN_PACK seats arrivals by best fit but fills the tables freed by
+// departures or the gate with the combination of waiting groups that takes
+// the most seats (make MODE_FLAGS=-DSEATING_POLICY=0)
+#define SEATING_FIRST_FIT 0
+#define SEATING_INDEXED 1
+#define SEATING_BIN_PACK 2
+#ifndef SEATING_POLICY
+#define SEATING_POLICY SEATING_INDEXED
+#endif
+
+// Seating pass: 1 = match queued groups only against tables whose capacity
+// changed since the last pass, 0 = retry both queues against every table
+// (make MODE_FLAGS=-DINCREMENTAL_SEATING=0)
+#ifndef INCREMENTAL_SEATING
+#define INCREMENTAL_SEATING 1
+#endif
+
+// Queue priority: 1 = earliest deadline first across both queues, a group's
+// deadline being its queueing time, plus VIP_PRIORITY_BOOST_MS for normal
+// groups, so a normal group that has waited that much longer than a VIP goes
+// first and normal waits stay bounded; 0 = VIPs always first
+// (make MODE_FLAGS=-DVIP_AGING=0)
+#ifndef VIP_AGING
+#define VIP_AGING 1
+#endif
+#define VIP_PRIORITY_BOOST_MS 2000
+
+// Bin-packing seats a group that fits and is this far past its deadline
+// before packing the rest of the table (VIP_AGING)
+#define SEAT_OVERDUE_MS 1000
+
+// Reneging: a queued group leaves after its patience, drawn per group from
+// GROUP_PATIENCE_MS +-50%; the service rejects it (REQ_GROUP_REJECT) and
+// reports it as lost. 0 = groups wait forever (default)
+// (make MODE_FLAGS=-DGROUP_PATIENCE_MS=200 to see groups leave)
+#ifndef GROUP_PATIENCE_MS
+#define GROUP_PATIENCE_MS 0
+#endif
+
+// Group processes: 0 forks one process per group; N hands groups to a pool
+// of N pre-forked workers through shared memory (GroupHandoff), each running
+// its groups as threads (make MODE_FLAGS=-DGROUP_WORKERS=4)
+#ifndef GROUP_WORKERS
+#define GROUP_WORKERS 0
+#endif
+#define GROUP_HANDOFF_SIZE 64
+
+// A worker's group has no pid of its own; it uses GROUP_KEY_BASE + groupID,
+// above any kernel pid (pid_max <= 2^22), wherever the protocol wants one
+#define GROUP_KEY_BASE (1 << 22)
+
+// People of a seated group: 1 = fibers multiplexed on the group's thread, a
+// belt wait suspends only the fiber; 0 = one pthread each
+// (make MODE_FLAGS=-DPERSON_FIBERS=0)
+#ifndef PERSON_FIBERS
+#define PERSON_FIBERS 1
+#endif
+#define PERSON_FIBER_STACK (64 * 1024)
+
+// Diners that find nothing in their window sleep until a dish is placed in
+// it or rolls into it (per-table events); 0 = yield and scan again
+#ifndef DISH_NOTIFY
+#define DISH_NOTIFY 1
+#endif
+
+// One person at a time scans the table window for the whole group and claims
+// a dish per person into the group's queue; 0 = every person scans for itself
+// (make MODE_FLAGS=-DGROUP_SCANNER=0)
+#ifndef GROUP_SCANNER
+#define GROUP_SCANNER 1
+#endif
+
+// Time-to-table histogram per class: WAIT_HIST_STEP_MS wide buckets, the
+// last one open-ended
+#define WAIT_HIST_STEP_MS 5
+#define WAIT_HIST_BUCKETS 2001
+
+// Premium placement: 1 = into the ordering table's window or the nearest free
+// slot upstream of it, 0 = first free slot like any other dish
+#ifndef PREMIUM_ROUTING
+#define PREMIUM_ROUTING 1
+#endif
 
 // Table configuration based on test mode
 #if TABLE_SHARING_TEST == 1
@@ -78,6 +201,17 @@
 #define COLOR_COUNT 6
 #define MAX_TABLE_SLOTS 4
 
+// Belt windows: each table sees BELT_WINDOW_SLOTS logical positions. The belt
+// is locked in segments of the same size (the last one also owns the tail
+// that lies past every table window).
+#define BELT_WINDOW_SLOTS (BELT_SIZE / TABLE_COUNT > 0 ? BELT_SIZE / TABLE_COUNT : 1)
+#define BELT_SEGMENTS (TABLE_COUNT < BELT_SIZE ? TABLE_COUNT : BELT_SIZE)
+
+// Free-capacity index buckets: free seats (0..MAX_TABLE_SLOTS) x occupant
+// class (empty, one group size, mixed) x VIP eligibility (see seating.h)
+#define SEAT_CLASSES (MAX_TABLE_SLOTS + 2)
+#define SEAT_BUCKETS ((MAX_TABLE_SLOTS + 1) * SEAT_CLASSES * 2)
+
 // ============================================================================
 // DATA STRUCTURES
 // ============================================================================
@@ -113,13 +247,33 @@ static int colorToIndex(colors c) {
     return -1;
 }
 
+// Monotonic clock in nanoseconds (premium delivery and seating wait times)
+static inline long long monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 typedef enum { OPEN = 1, SLOW_MODE = 2, FAST_MODE = 3, CLOSED = 4 } restaurantMode;
 
-// Queue structure for Groups waiting for a table
+// Queue structure for Groups waiting for a table: one doubly linked list
+// per group size, in arrival order, over a shared pool of MAX_QUEUE nodes
+// (-1 terminated), so push, pop and removal from the middle are O(1).
+// seq orders arrivals across the size lists.
 struct GroupQueue {
     int groupPid[MAX_QUEUE];
     int groupSize[MAX_QUEUE];
     int groupID[MAX_QUEUE];
+    int mailbox[MAX_QUEUE]; // Reply mailbox index (GROUP_MAILBOXES)
+    int seq[MAX_QUEUE];     // Global arrival number (RestaurantState::queueSeq)
+    long long queuedNs[MAX_QUEUE]; // Monotonic time the group was queued
+    long long expireNs[MAX_QUEUE]; // Monotonic time the group gives up, 0 = never
+    int next[MAX_QUEUE];
+    int prev[MAX_QUEUE];
+    int head[MAX_GROUP_SIZE + 1]; // Oldest waiting node per group size
+    int tail[MAX_GROUP_SIZE + 1]; // Newest waiting node per group size
+    int sizeCount[MAX_GROUP_SIZE + 1]; // Waiting groups per group size
+    int freeHead;           // Unused nodes, chained through next
     int count;
 };
 
@@ -138,7 +292,13 @@ struct Table {
     TableSlot slots[MAX_TABLE_SLOTS];
 };
 
-// Represents a dish on the conveyor belt
+// Futex-backed wait/notify on a shared counter
+struct ShmEvent {
+    int seq;        // Futex word, bumped on every notify
+    int waiters;    // Number of sleepers inside eventWait
+};
+
+// Represents a single dish (as cooked by the chef or taken by a consumer)
 struct Dish {
     int dishID;
     colors color;
@@ -146,6 +306,26 @@ struct Dish {
     int targetGroupID; // -1 if available for anyone
 };
 
+#if BELT_LOCKFREE
+// Lock-free belt: one packed word per physical slot (see beltPack in belt.h),
+// 0 if the slot is empty. The atomics live in the SysV segment and are shared
+// between processes, which is only valid for address-free lock-free atomics.
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "belt slots must be lock-free atomics");
+
+struct BeltLanes {
+    std::atomic<uint64_t> slot[BELT_SIZE];
+};
+#else
+// Conveyor belt storage in structure-of-arrays layout, indexed by physical slot.
+// Contiguous lanes let the consumer match and zombie sweep run as SIMD kernels.
+struct BeltLanes {
+    int dishID[BELT_SIZE];        // 0 if slot is empty
+    colors color[BELT_SIZE];
+    int price[BELT_SIZE];
+    int targetGroupID[BELT_SIZE]; // -1 if available for anyone
+};
+#endif
+
 typedef enum {
     SPEED_SLOW = 0,
     SPEED_NORMAL = 1,
@@ -154,6 +334,25 @@ typedef enum {
 
 class Group;
 
+// Group handed to a pool worker (GROUP_WORKERS)
+typedef struct {
+    int groupID;
+    int groupSize;
+    int adultCount;
+    int childCount;
+    bool vipStatus;
+    int dishesToEat;
+    int ordersLeft;
+    int patienceMs;
+} GroupSpec;
+
+// Clients -> workers ring: SEM_HANDOFF_FREE/ITEMS count slots
+typedef struct {
+    GroupSpec spec[GROUP_HANDOFF_SIZE];
+    int head;   // Next spec to take (SEM_MUTEX_HANDOFF)
+    int tail;   // Next spec to fill (clients process only)
+} GroupHandoff;
+
 // Shared Memory State Structure
 // Holds the entire state of the restaurant accessible by all processes
 struct RestaurantState {
@@ -173,10 +372,35 @@ struct RestaurantState {
     long long totalPauseNanoseconds;
 
     Table tables[TABLE_COUNT];
-    Dish belt[BELT_SIZE];
+
+    // Free-capacity index (SEM_MUTEX_STATE): bucket seatKey heads a -1
+    // terminated doubly linked list of tables, seatBucketMask has a bit per
+    // non-empty bucket
+    uint64_t seatBucketMask;
+    int seatHead[SEAT_BUCKETS];
+    int seatNext[TABLE_COUNT];
+    int seatPrev[TABLE_COUNT];
+    int seatKey[TABLE_COUNT];
+
+    BeltLanes belt;             // Ring buffer, indexed by physical slot
+    int beltOffset;             // Rotation offset: logical = (physical + beltOffset) % BELT_SIZE
+#if !BELT_LOCKFREE
+    uint64_t beltOccupied[BELT_WORDS]; // Bit per physical slot, set while a dish is on it (atomic ops)
+
+    // Index of targeted (premium) dishes: bucket groupID % BELT_SIZE heads a
+    // doubly linked list of physical slots, -1 terminated (SEM_MUTEX_TARGETS)
+    int targetHead[BELT_SIZE];
+    int targetNext[BELT_SIZE];
+    int targetPrev[BELT_SIZE];
+#endif
+    int beltItemCount;          // Dishes on the belt (atomic ops); lock-free mode also counts reserved and claimed slots
+    ShmEvent windowDish[TABLE_COUNT]; // Bumped when a dish enters the table's window (DISH_NOTIFY)
+    long long beltWindowScans;  // Window scans, one lock of the window each (atomic ops)
+    long long beltScansWasted;  // Window scans that took no dish (atomic ops)
 
     GroupQueue normalQueue;
     GroupQueue vipQueue;
+    int queueSeq;               // Next arrival number (SEM_MUTEX_QUEUE)
 
     // Statistics
     int producedCount[COLOR_COUNT];
@@ -187,6 +411,42 @@ struct RestaurantState {
     int wastedCount[COLOR_COUNT];
     int wastedValue[COLOR_COUNT];
     int revenue;
+
+    // Seating (service, SEM_MUTEX_STATE): wait from queueing to a table, and
+    // occupied seats integrated over time since the first seating
+    int groupsSeated;
+    long long seatWaitNs;           // Sum over seated groups (0 if seated on arrival)
+    long long seatWaitMaxNs;
+    long long occupiedSeatNs;       // Sum of currentGuestCount x elapsed ns
+    long long seatClockStartNs;
+    long long seatClockLastNs;
+    int seatWaitHist[2][WAIT_HIST_BUCKETS]; // [vip] waits, WAIT_HIST_STEP_MS buckets
+
+    // Groups that left the queue out of patience (service, SEM_MUTEX_STATE)
+    int groupsLost[2];              // [vip]
+    int peopleLost[2];
+    long long lostWaitNs;           // Sum of their waits
+
+    // Premium order-to-delivery times (atomic ops)
+    int premiumOrdered;
+    int premiumDelivered;
+    long long premiumDeliveryNs;    // Sum over delivered orders
+    long long premiumDeliveryMaxNs;
+
+    // Group creation (clients, atomic ops)
+    GroupHandoff handoff;
+    long long groupCreateFirstNs;
+    long long groupCreateLastNs;
+    int groupProcs;                 // Live group or worker processes
+    int groupProcsPeak;
+    int groupsLive;                 // Groups created and not finished yet
+    int groupsLivePeak;
+
+    // Person execution (clients, atomic ops)
+    long long personCswVoluntary;   // Context switches of threads running people
+    long long personCswInvoluntary;
+    long long groupRssKb;           // Sum of group/worker process peak RSS
+    int groupRssGuests;             // Seated guests of those processes (fork per group)
 };
 
 // Semaphore Indices
@@ -194,7 +454,6 @@ enum {
     SEM_MUTEX_STATE = 0,    // Protects shared memory state
     SEM_MUTEX_LOGS,         // Protects FIFO logging
 
-    SEM_MUTEX_BELT,         // Protects belt array access
     SEM_BELT_SLOTS,         // Counts empty slots on belt (Producer throttling)
     SEM_BELT_ITEMS,         // Counts items on belt (Consumer indication)
 
@@ -214,5 +473,13 @@ enum {
     SEM_QUEUE_USED_VIP,     // (Legacy) could indicate used VIP slots
     SEM_QUEUE_USED_NORMAL,  // (Legacy) could indicate used Normal slots
 
-    SEM_COUNT
+    SEM_MUTEX_TARGETS,      // Protects the targeted dish index (taken after a belt segment)
+
+    SEM_MUTEX_HANDOFF,      // Protects the group handoff head
+    SEM_HANDOFF_FREE,       // Counts free handoff slots
+    SEM_HANDOFF_ITEMS,      // Counts groups waiting for a worker
+
+    SEM_BELT_SEGMENT,       // First of BELT_SEGMENTS locks, each protects one belt window
+
+    SEM_COUNT = SEM_BELT_SEGMENT + BELT_SEGMENTS
 };
@@ -0,0 +1,190 @@
+﻿#include "fiber.h"
+#include "ipc_manager.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+struct Fiber {
+    ucontext_t ctx;
+    void* stack;        // mmap'd, the lowest page is a guard
+    size_t mapSize;
+    void (*body)(void*);
+    void* arg;
+    int waitSem;        // Semaphore the fiber is parked on, -1 if none
+    bool granted;       // The scheduler took a waitSem token for the fiber
+    ShmEvent* waitEvent; // Event the fiber is parked on, until seq != waitSeen
+    int waitSeen;
+    bool localEvent;    // waitEvent is only signalled by fibers of this thread
+    bool done;
+};
+
+struct FiberSched {
+    ucontext_t main;
+    Fiber* fibers;
+    int current;
+    bool yielded;       // A fiber found nothing to do this round
+};
+
+static thread_local FiberSched* sched = nullptr;
+
+// Nap between polls when the parked fibers share no cross-process wait
+static const long long FIBER_POLL_NS = 1000000LL;
+
+// Every live fiber is parked. Blocking on one fiber's wait misses wakeups
+// meant for the others, and a local event could never fire meanwhile, so
+// sleep fully only on a cross-process wait every parked fiber shares
+static void blockParked(Fiber* fibers, int count) {
+    Fiber* first = NULL;
+    bool shared = true;
+
+    for (int i = 0; i < count; ++i) {
+        Fiber& f = fibers[i];
+        if (f.done) continue;
+        if (f.waitEvent && f.localEvent) {
+            shared = false;
+            continue;
+        }
+        if (!first)
+            first = &f;
+        else if (f.waitSem != first->waitSem || f.waitEvent != first->waitEvent)
+            shared = false;
+    }
+
+    if (first && first->waitEvent) {
+        if (shared)
+            eventWait(first->waitEvent, first->waitSeen);
+        else
+            eventWait(first->waitEvent, first->waitSeen, FIBER_POLL_NS);
+    } else if (first && shared) {
+        P(first->waitSem);
+        if (!terminate_flag && !evacuate_flag)
+            first->granted = true;
+    } else {
+        usleep(FIBER_POLL_NS / 1000);
+    }
+}
+
+static void fiberEntry() {
+    Fiber& f = sched->fibers[sched->current];
+    f.body(f.arg);
+    f.done = true;      // uc_link switches back to the scheduler
+}
+
+void fiberRun(int count, void (*body)(void*), void* const args[], size_t stackSize) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    Fiber fibers[count];
+    FiberSched s;
+    s.fibers = fibers;
+    s.current = -1;
+    sched = &s;
+
+    int alive = 0;
+    for (int i = 0; i < count; ++i) {
+        Fiber& f = fibers[i];
+        f.body = body;
+        f.arg = args[i];
+        f.waitSem = -1;
+        f.granted = false;
+        f.waitEvent = NULL;
+        f.localEvent = false;
+        f.done = true;
+        f.mapSize = stackSize + page;
+        f.stack = mmap(NULL, f.mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (f.stack == MAP_FAILED) {
+            handleError(ERR_MEM_ALLOC, "fiber stack mmap", errno);
+            f.stack = NULL;
+            continue;
+        }
+        mprotect(f.stack, page, PROT_NONE);
+
+        getcontext(&f.ctx);
+        f.ctx.uc_stack.ss_sp = f.stack;
+        f.ctx.uc_stack.ss_size = f.mapSize;
+        f.ctx.uc_link = &s.main;
+        makecontext(&f.ctx, fiberEntry, 0);
+        f.done = false;
+        alive++;
+    }
+
+    while (alive > 0) {
+        bool ran = false;
+        bool parked = false;
+        s.yielded = false;
+
+        for (int i = 0; i < count; ++i) {
+            Fiber& f = fibers[i];
+            if (f.done) continue;
+
+            // A parked fiber resumes with a token, or to see the shutdown flags
+            if (f.waitSem != -1 && !f.granted && !terminate_flag && !evacuate_flag) {
+                if (!tryP(f.waitSem)) {
+                    parked = true;
+                    continue;
+                }
+                f.granted = true;
+            }
+            if (f.waitEvent && !terminate_flag && !evacuate_flag &&
+                __atomic_load_n(&f.waitEvent->seq, __ATOMIC_SEQ_CST) == f.waitSeen) {
+                parked = true;
+                continue;
+            }
+
+            s.current = i;
+            swapcontext(&s.main, &f.ctx);
+            ran = true;
+            if (f.done) alive--;
+        }
+
+        if (!ran && parked) {
+            blockParked(fibers, count);
+        } else if (s.yielded) {
+            sched_yield();
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+        if (fibers[i].stack) munmap(fibers[i].stack, fibers[i].mapSize);
+    sched = nullptr;
+}
+
+void fiberYield() {
+    if (!sched) {
+        sched_yield();
+        return;
+    }
+
+    sched->yielded = true;
+    swapcontext(&sched->fibers[sched->current].ctx, &sched->main);
+}
+
+void fiberP(int semnum) {
+    if (!sched) {
+        P(semnum);
+        return;
+    }
+    if (tryP(semnum))
+        return;
+
+    Fiber& f = sched->fibers[sched->current];
+    f.waitSem = semnum;
+    swapcontext(&f.ctx, &sched->main);
+    f.waitSem = -1;
+    f.granted = false;
+}
+
+void fiberWaitEvent(ShmEvent* ev, int seen, bool local) {
+    if (!sched) {
+        eventWait(ev, seen);
+        return;
+    }
+    if (__atomic_load_n(&ev->seq, __ATOMIC_SEQ_CST) != seen)
+        return;
+
+    Fiber& f = sched->fibers[sched->current];
+    f.waitEvent = ev;
+    f.waitSeen = seen;
+    f.localEvent = local;
+    swapcontext(&f.ctx, &sched->main);
+    f.waitEvent = NULL;
+}
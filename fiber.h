@@ -0,0 +1,22 @@
+﻿#pragma once
+#include "common.h"
+#include <stddef.h>
+
+// Cooperative fibers for the people of a seated group (PERSON_FIBERS).
+// fiberRun() runs count bodies on ucontext stacks, one at a time on the
+// calling thread; a fiber only gives way at fiberYield() or at a wait that
+// cannot be satisfied at once, so it never switches holding a lock. When
+// every fiber waits, the thread blocks only on a cross-process wait they
+// all share; otherwise it naps on one for FIBER_POLL_NS and re-polls all.
+
+void fiberRun(int count, void (*body)(void*), void* const args[], size_t stackSize);
+
+// Lets the other fibers of this thread run (sched_yield() outside fibers)
+void fiberYield();
+
+// P() that suspends the calling fiber instead of its thread
+void fiberP(int semnum);
+
+// eventWait() that suspends the calling fiber instead of its thread; local
+// marks an event only this thread's fibers signal, never slept on
+void fiberWaitEvent(ShmEvent* ev, int seen, bool local = false);
@@ -10,6 +10,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <limits.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 key_t SHM_KEY = -1;
 key_t SEM_KEY = -1;
@@ -24,10 +28,17 @@ int serviceQid = -1;
 int premiumQid = -1;
 
 RestaurantState* state = nullptr;
+FutexSem* semTable = nullptr;
+MsgRings* msgRings = nullptr;
+GroupRegistry* groupRegistry = nullptr;
 
 int fifoFdWrite = -1;
 int fifoFdRead = -1;
 
+static long futex(int* addr, int op, int val, const struct timespec* timeout) {
+    return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
 // ============================================================================
 // QUEUE HELPERS
 // ============================================================================
@@ -118,9 +129,9 @@ void queueSend(int qid, int semFree, int semItems,
 template<typename T>
 bool queueRecv(int qid, int semItems, int semFree,
     T& msg, long mtype,
-    ErrorCode err, const char* errMsg)
+    ErrorCode err, const char* errMsg, bool wait = true)
 {
-    constexpr int baseFlags = QueueRecvTraits<T>::flags;
+    const int baseFlags = QueueRecvTraits<T>::flags | (wait ? 0 : IPC_NOWAIT);
 
     for (;;) {
         if (terminate_flag || evacuate_flag)
@@ -155,6 +166,120 @@ bool queueRecv(int qid, int semItems, int semFree,
     }
 }
 
+// Sleeps until ev moves past seen, for at most timeoutNs (500ms by default
+// to allow flag checking). Each sleeper counts itself in waiters for the
+// length of its wait, like the futex semaphores
+void eventWait(ShmEvent* ev, int seen, long long timeoutNs) {
+    struct timespec ts = { (time_t)(timeoutNs / 1000000000LL), (long)(timeoutNs % 1000000000LL) };
+
+    // Announce the waiter before sleeping; the kernel re-checks seq == seen
+    __atomic_fetch_add(&ev->waiters, 1, __ATOMIC_SEQ_CST);
+    futex(&ev->seq, FUTEX_WAIT, seen, &ts);
+    __atomic_fetch_sub(&ev->waiters, 1, __ATOMIC_RELAXED);
+}
+
+// Wakes all sleepers; no syscall if nobody waits
+void eventNotify(ShmEvent* ev) {
+    __atomic_fetch_add(&ev->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ev->waiters, __ATOMIC_SEQ_CST) != 0)
+        futex(&ev->seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+#if SHM_QUEUES
+template<typename T, int N>
+static void ringInit(ShmRing<T, N>& r) {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    memset((void*)&r, 0, sizeof(r));
+    for (int i = 0; i < N; ++i)
+        r.cells[i].seq = i;
+}
+
+template<typename T, int N>
+static bool ringTryPush(ShmRing<T, N>& r, const T& msg) {
+    unsigned pos = __atomic_load_n(&r.tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        auto& cell = r.cells[pos % N];
+        unsigned seq = __atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE);
+        int diff = (int)(seq - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&r.tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell.msg = msg;
+                __atomic_store_n(&cell.seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // Full: the consumer has not released this cell yet
+        } else {
+            pos = __atomic_load_n(&r.tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+template<typename T, int N>
+static bool ringTryPop(ShmRing<T, N>& r, T& msg) {
+    unsigned pos = r.head;
+    auto& cell = r.cells[pos % N];
+
+    if ((int)(__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) - (pos + 1)) < 0)
+        return false; // Empty, or the producer is still copying
+
+    msg = cell.msg;
+    __atomic_store_n(&cell.seq, pos + N, __ATOMIC_RELEASE);
+    __atomic_store_n(&r.head, pos + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// Blocking push; waits while the ring is full
+template<typename T, int N>
+static void ringSend(ShmRing<T, N>& r, const T& msg) {
+    for (;;) {
+        if (terminate_flag || evacuate_flag)
+            return;
+
+        int seen = __atomic_load_n(&r.notFull.seq, __ATOMIC_SEQ_CST);
+        if (ringTryPush(r, msg)) {
+            eventNotify(&r.notEmpty);
+            return;
+        }
+        eventWait(&r.notFull, seen);
+    }
+}
+
+// Pop; with wait set it blocks while the ring is empty, up to the monotonic
+// deadlineNs if one is given
+template<typename T, int N>
+static bool ringRecv(ShmRing<T, N>& r, T& msg, bool wait, long long deadlineNs = 0) {
+    for (;;) {
+        if (terminate_flag || evacuate_flag)
+            return false;
+
+        int seen = __atomic_load_n(&r.notEmpty.seq, __ATOMIC_SEQ_CST);
+        if (ringTryPop(r, msg)) {
+            eventNotify(&r.notFull);
+            return true;
+        }
+        if (!wait)
+            return false;
+
+        if (deadlineNs > 0) {
+            long long left = deadlineNs - monotonicNs();
+            if (left <= 0)
+                return false;
+            eventWait(&r.notEmpty, seen, left < 500000000LL ? left : 500000000LL);
+        } else {
+            eventWait(&r.notEmpty, seen);
+        }
+    }
+}
+
+template<typename T, int N>
+static int ringFree(const ShmRing<T, N>& r) {
+    return N - (int)(__atomic_load_n(&r.tail, __ATOMIC_RELAXED) - __atomic_load_n(&r.head, __ATOMIC_RELAXED));
+}
+#endif
+
 // --- Type-safe Wrappers ---
 
 void queueSendRequest(const ServiceRequest& msg) {
@@ -176,6 +301,35 @@ void queueRecvRequest(ServiceRequest& msg, long mtype) {
         "msgrcv ServiceRequest failed");
 }
 
+#if SHM_QUEUES
+void queueSendRequest(const PremiumRequest& msg) {
+    ringSend(msgRings->premium, msg);
+}
+
+bool queueRecvRequest(PremiumRequest& msg, long mtype) {
+    return ringRecv(msgRings->premium, msg, false); // Polled by the chef
+}
+
+void queueSendRequest(const ClientRequest& msg) {
+    ringSend(msgRings->client, msg);
+}
+
+void queueRecvRequest(ClientRequest& msg, long mtype) {
+    ringRecv(msgRings->client, msg, true);
+}
+
+bool queueTryRecvRequest(ClientRequest& msg) {
+    return ringRecv(msgRings->client, msg, false);
+}
+
+bool queueRecvRequestUntil(ClientRequest& msg, long long deadlineNs) {
+    return ringRecv(msgRings->client, msg, true, deadlineNs);
+}
+
+int clientQueueFree() {
+    return ringFree(msgRings->client);
+}
+#else
 void queueSendRequest(const PremiumRequest& msg) {
     queueSend(premiumQid,
         SEM_PREMIUM_FREE,
@@ -214,6 +368,120 @@ void queueRecvRequest(ClientRequest& msg, long mtype) {
         "msgrcv ClientRequest failed");
 }
 
+bool queueTryRecvRequest(ClientRequest& msg) {
+    return queueRecv(clientQid,
+        SEM_CLIENT_ITEMS,
+        SEM_CLIENT_FREE,
+        msg,
+        0,
+        ERR_IPC_MSG,
+        "msgrcv ClientRequest failed",
+        false);
+}
+
+// msgrcv has no timeout, so the deadline is polled
+bool queueRecvRequestUntil(ClientRequest& msg, long long deadlineNs) {
+    while (!queueTryRecvRequest(msg)) {
+        if (terminate_flag || evacuate_flag || monotonicNs() >= deadlineNs)
+            return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+int clientQueueFree() {
+    return getSemValue(SEM_CLIENT_FREE);
+}
+#endif
+
+#if GROUP_MAILBOXES
+// Scans from groupID for a free entry; the registry is sized for every live group
+int groupMailboxOpen(pid_t pid, int groupID) {
+    for (;;) {
+        for (int k = 0; k < GROUP_REGISTRY_SIZE; ++k) {
+            int i = (groupID + k) % GROUP_REGISTRY_SIZE;
+            GroupEntry& e = groupRegistry->entry[i];
+            pid_t expected = 0;
+
+            if (__atomic_load_n(&e.owner, __ATOMIC_RELAXED) != 0)
+                continue;
+            if (__atomic_compare_exchange_n(&e.owner, &expected, pid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                e.groupID = groupID;
+                e.full = 0;
+                e.table = e.slot = -1;
+                return i;
+            }
+        }
+        if (terminate_flag || evacuate_flag)
+            return -1;
+        sched_yield();
+    }
+}
+
+void groupMailboxClose(int mailbox) {
+    if (mailbox < 0) return;
+    __atomic_store_n(&groupRegistry->entry[mailbox].owner, 0, __ATOMIC_RELEASE);
+}
+
+void groupReplySend(int mailbox, const ServiceRequest& msg) {
+    GroupEntry& e = groupRegistry->entry[mailbox];
+
+    e.reply = msg;
+    __atomic_store_n(&e.full, 1, __ATOMIC_RELEASE);
+    eventNotify(&e.ready);
+}
+
+void groupReplyRecv(int mailbox, pid_t pid, ServiceRequest& msg) {
+    GroupEntry& e = groupRegistry->entry[mailbox];
+
+    while (!terminate_flag && !evacuate_flag) {
+        int seen = __atomic_load_n(&e.ready.seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&e.full, __ATOMIC_ACQUIRE)) {
+            msg = e.reply;
+            __atomic_store_n(&e.full, 0, __ATOMIC_RELAXED);
+            return;
+        }
+        eventWait(&e.ready, seen);
+    }
+}
+
+void groupRecordSeat(int mailbox, int table, int slot) {
+    if (mailbox < 0) return;
+    groupRegistry->entry[mailbox].table = table;
+    groupRegistry->entry[mailbox].slot = slot;
+}
+
+bool groupFindSeat(int mailbox, int groupID, int& table, int& slot) {
+    if (mailbox < 0) return false;
+
+    const GroupEntry& e = groupRegistry->entry[mailbox];
+    if (e.groupID != groupID || e.table == -1) return false;
+    table = e.table;
+    slot = e.slot;
+    return true;
+}
+#else
+int groupMailboxOpen(pid_t pid, int groupID) {
+    return -1;
+}
+
+void groupMailboxClose(int mailbox) {}
+
+void groupReplySend(int mailbox, const ServiceRequest& msg) {
+    queueSendRequest(msg);
+}
+
+void groupReplyRecv(int mailbox, pid_t pid, ServiceRequest& msg) {
+    queueRecvRequest(msg, pid);
+}
+
+void groupRecordSeat(int mailbox, int table, int slot) {}
+
+bool groupFindSeat(int mailbox, int groupID, int& table, int& slot) {
+    return false;
+}
+#endif
+
 void queueSendResponse(const ClientResponse& msg) {
     queueSend(clientQid,
         SEM_CLIENT_FREE,
@@ -312,7 +580,87 @@ void loggerLoop(const char* filename) {
 // SEMAPHORES
 // ============================================================================
 
-static void semSet(int semnum, int val) {
+#if FUTEX_SEMAPHORES
+void semSet(int semnum, int val) {
+    __atomic_store_n(&semTable[semnum].value, val, __ATOMIC_SEQ_CST);
+}
+
+// Wait (Decrement) operation; parks on the futex for at most 500ms at a time
+// to allow flag checking. Uncontended it never leaves user space.
+void P(int semnum) {
+    FutexSem* s = &semTable[semnum];
+    struct timespec ts;
+
+    for (;;) {
+        if (terminate_flag || evacuate_flag)
+            return;
+
+        int val = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+        while (val > 0) {
+            if (__atomic_compare_exchange_n(&s->value, &val, val - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                return;
+        }
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 500000000; // 500ms
+
+        // Announce the waiter before sleeping; the kernel re-checks value == 0
+        __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+        long ret = futex(&s->value, FUTEX_WAIT, 0, &ts);
+        int savedErrno = errno;
+        __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_RELAXED);
+
+        if (ret == 0 || savedErrno == EAGAIN || savedErrno == ETIMEDOUT || savedErrno == EINTR)
+            continue;
+
+        ErrorDecision d = handleError(ERR_SEM_OP, "futex wait P", savedErrno);
+
+        if (d == ERR_DECISION_IGNORE)
+            return;
+        if (d == ERR_DECISION_FATAL)
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Non-blocking Wait (Decrement) operation
+bool tryP(int semnum) {
+    FutexSem* s = &semTable[semnum];
+
+    int val = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+    while (val > 0) {
+        if (__atomic_compare_exchange_n(&s->value, &val, val - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+// Signal (Increment) operation; wakes one waiter only if somebody is parked
+void V(int semnum) {
+    FutexSem* s = &semTable[semnum];
+
+    __atomic_fetch_add(&s->value, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) == 0)
+        return;
+
+    for (;;) {
+        ErrorDecision d = CHECK_ERR(futex(&s->value, FUTEX_WAKE, 1, NULL),
+            ERR_SEM_OP, "futex wake V");
+
+        if (d == ERR_DECISION_RETRY)
+            continue;
+
+        if (d == ERR_DECISION_FATAL)
+            exit(EXIT_FAILURE);
+
+        return;
+    }
+}
+
+int getSemValue(int semnum) {
+    return __atomic_load_n(&semTable[semnum].value, __ATOMIC_RELAXED);
+}
+#else
+void semSet(int semnum, int val) {
     union semun {
         int val;
         struct semid_ds* buf;
@@ -364,6 +712,18 @@ void P(int semnum) {
     }
 }
 
+// Non-blocking Wait (Decrement) operation
+bool tryP(int semnum) {
+    struct sembuf op = { (unsigned short)semnum, -1, IPC_NOWAIT };
+
+    for (;;) {
+        if (semop(semId, &op, 1) != -1)
+            return true;
+        if (errno != EINTR)
+            return false;
+    }
+}
+
 // Signal (Increment) operation
 void V(int semnum) {
     struct sembuf op = { (unsigned short)semnum, 1, 0 };
@@ -388,34 +748,71 @@ int getSemValue(int semnum) {
     if (val == -1) return -1;
     return val;
 }
+#endif
+
+void queueInit(GroupQueue& q) {
+    for (int k = 0; k <= MAX_GROUP_SIZE; ++k) {
+        q.head[k] = q.tail[k] = -1;
+        q.sizeCount[k] = 0;
+    }
+    q.count = 0;
+    for (int i = 0; i < MAX_QUEUE; ++i) {
+        q.next[i] = i + 1 < MAX_QUEUE ? i + 1 : -1;
+        q.prev[i] = -1;
+    }
+    q.freeHead = 0;
+}
+
+void queueRemove(GroupQueue& q, int node) {
+    int size = q.groupSize[node];
+    int next = q.next[node];
+    int prev = q.prev[node];
+
+    if (prev != -1) q.next[prev] = next;
+    else q.head[size] = next;
+    if (next != -1) q.prev[next] = prev;
+    else q.tail[size] = prev;
+
+    q.next[node] = q.freeHead;
+    q.prev[node] = -1;
+    q.freeHead = node;
+    q.sizeCount[size]--;
+    q.count--;
+}
 
 // Used to push group into local process memory queues (VIP/Normal)
-bool queuePush(pid_t groupPid, bool vipStatus, int groupSize, int groupID) {
+bool queuePush(pid_t groupPid, bool vipStatus, int groupSize, int groupID, int mailbox, int patienceMs, long long& expireNs) {
 
     if (terminate_flag || evacuate_flag)
         return false;
 
     P(SEM_MUTEX_QUEUE);
 
-    if (vipStatus) {
-        if (state->vipQueue.count >= MAX_QUEUE) {
-           V(SEM_MUTEX_QUEUE);
-           return false; 
-        }
-        state->vipQueue.groupPid[state->vipQueue.count] = groupPid;
-        state->vipQueue.groupSize[state->vipQueue.count] = groupSize;
-        state->vipQueue.groupID[state->vipQueue.count] = groupID;
-        state->vipQueue.count++;
-    } else {
-        if (state->normalQueue.count >= MAX_QUEUE) {
-           V(SEM_MUTEX_QUEUE);
-           return false; 
-        }
-        state->normalQueue.groupPid[state->normalQueue.count] = groupPid;
-        state->normalQueue.groupSize[state->normalQueue.count] = groupSize;
-        state->normalQueue.groupID[state->normalQueue.count] = groupID;
-        state->normalQueue.count++;
+    GroupQueue& q = vipStatus ? state->vipQueue : state->normalQueue;
+    int node = q.freeHead;
+    if (node == -1 || groupSize < 1 || groupSize > MAX_GROUP_SIZE) {
+       V(SEM_MUTEX_QUEUE);
+       return false; 
     }
+    q.freeHead = q.next[node];
+
+    q.groupPid[node] = groupPid;
+    q.groupSize[node] = groupSize;
+    q.groupID[node] = groupID;
+    q.mailbox[node] = mailbox;
+    q.seq[node] = state->queueSeq++;
+    q.queuedNs[node] = monotonicNs();
+    q.expireNs[node] = patienceMs > 0 ? q.queuedNs[node] + patienceMs * 1000000LL : 0;
+    expireNs = q.expireNs[node];
+
+    // Append at the tail of its size list to keep arrival order
+    q.next[node] = -1;
+    q.prev[node] = q.tail[groupSize];
+    if (q.tail[groupSize] != -1) q.next[q.tail[groupSize]] = node;
+    else q.head[groupSize] = node;
+    q.tail[groupSize] = node;
+    q.sizeCount[groupSize]++;
+    q.count++;
 
     V(SEM_MUTEX_QUEUE);
     
@@ -430,20 +827,54 @@ int ipcInit() {
     SHM_KEY = ftok(".", 'A'); CHECK_ERR(SHM_KEY, ERR_IPC_INIT, "ftok SHM");
     SEM_KEY = ftok(".", 'B'); CHECK_ERR(SEM_KEY, ERR_IPC_INIT, "ftok SEM");
 
-    shmId = shmget(SHM_KEY, sizeof(RestaurantState), IPC_CREAT | 0600);
+    // Layout: RestaurantState, then the futex semaphores, the request rings
+    // and the group registry
+    size_t shmSize = sizeof(RestaurantState);
+#if FUTEX_SEMAPHORES
+    shmSize += SEM_COUNT * sizeof(FutexSem);
+#endif
+#if SHM_QUEUES
+    shmSize += sizeof(MsgRings);
+#endif
+#if GROUP_MAILBOXES
+    shmSize += sizeof(GroupRegistry);
+#endif
+
+    shmId = shmget(SHM_KEY, shmSize, IPC_CREAT | 0600);
     CHECK_ERR(shmId, ERR_IPC_INIT, "shmget");
 
     state = (RestaurantState*)shmat(shmId, NULL, 0);
     CHECK_NULL(state, ERR_IPC_INIT, "shmat");
 
+    // Tables past the state, unused when every option below is off
+    [[maybe_unused]] char* extra = (char*)(state + 1);
+#if FUTEX_SEMAPHORES
+    semTable = (FutexSem*)extra;
+    memset(semTable, 0, SEM_COUNT * sizeof(FutexSem));
+    extra += SEM_COUNT * sizeof(FutexSem);
+#else
     semId = semget(SEM_KEY, SEM_COUNT, IPC_CREAT | 0600);
     CHECK_ERR(semId, ERR_IPC_INIT, "semget");
+#endif
+#if SHM_QUEUES
+    msgRings = (MsgRings*)extra;
+    ringInit(msgRings->client);
+    ringInit(msgRings->premium);
+    extra += sizeof(MsgRings);
+#endif
+#if GROUP_MAILBOXES
+    groupRegistry = (GroupRegistry*)extra;
+    memset((void*)groupRegistry, 0, sizeof(GroupRegistry));
+#endif
 
     // Initialize Semaphores
     semSet(SEM_MUTEX_STATE, 1);
     semSet(SEM_MUTEX_QUEUE, 1);
     semSet(SEM_MUTEX_LOGS, 1);
-    semSet(SEM_MUTEX_BELT, 1);
+    semSet(SEM_MUTEX_TARGETS, 1);
+    semSet(SEM_MUTEX_HANDOFF, 1);
+    for (int i = 0; i < BELT_SEGMENTS; ++i)
+        semSet(SEM_BELT_SEGMENT + i, 1);
 
     semSet(SEM_BELT_SLOTS, BELT_SIZE);
     semSet(SEM_BELT_ITEMS, 0);
@@ -464,13 +895,18 @@ int ipcInit() {
     semSet(SEM_PREMIUM_FREE, PREMIUM_QUEUE_SIZE);
     semSet(SEM_PREMIUM_ITEMS, 0);
 
+    semSet(SEM_HANDOFF_FREE, GROUP_HANDOFF_SIZE);
+    semSet(SEM_HANDOFF_ITEMS, 0);
+
     clientQid = createQueue(CLIENT_REQ_QUEUE);
     serviceQid = createQueue(SERVICE_REQ_QUEUE);
     premiumQid = createQueue(PREMIUM_REQ_QUEUE);
 
     fifoInit();
     fifoInitCloseSignal();
-    memset(state, 0, sizeof(RestaurantState));
+    memset((void*)state, 0, sizeof(RestaurantState));
+    queueInit(state->vipQueue);
+    queueInit(state->normalQueue);
     state->totalGroupsCreated = 0;
     state->startTime = time(NULL);
     state->totalPauseNanoseconds = 0;
@@ -5,6 +5,8 @@
 #define CLIENT_QUEUE_SIZE 256
 #define SERVICE_QUEUE_SIZE 1024
 #define PREMIUM_QUEUE_SIZE 1024
+// Upper bound on live groups: both waiting queues plus every table slot
+#define GROUP_REGISTRY_SIZE (2 * MAX_QUEUE + TABLE_COUNT * MAX_TABLE_SLOTS)
 
 // Project IDs for ftok
 #define CLIENT_REQ_QUEUE 'X'
@@ -56,6 +58,8 @@ typedef struct {
     int adultCount;
     int childCount;
     bool vipStatus;
+    int mailbox;                // Reply mailbox index (GROUP_MAILBOXES), -1 otherwise
+    int patienceMs;             // Time the group waits in the queue, 0 = forever
     int eatenCount[COLOR_COUNT]; // Stats for finish report
 } ClientRequest;
 
@@ -76,8 +80,61 @@ typedef struct {
     long mtype;
     int groupID;
     int dish; // Dish index desired
+    int tableIndex; // Table of the ordering group (premium routing)
 } PremiumRequest;
 
+// ============================================================================
+// SHARED MEMORY RINGS (SHM_QUEUES)
+// ============================================================================
+
+// Bounded multi-producer/single-consumer ring. Every cell carries a sequence
+// number: producers claim a cell by advancing tail and publish it by bumping
+// the cell's seq, so no lock is held while a message is copied in.
+// N must be a power of two.
+template<typename T, int N>
+struct ShmRing {
+    struct Cell {
+        unsigned seq;
+        T msg;
+    };
+
+    unsigned head;      // Next cell to read (consumer only)
+    unsigned tail;      // Next cell to claim (producers, CAS)
+    ShmEvent notEmpty;  // Bumped after every push
+    ShmEvent notFull;   // Bumped after every pop
+    Cell cells[N];
+};
+
+// Request rings, placed in the shared segment after the semaphores
+struct MsgRings {
+    ShmRing<ClientRequest, CLIENT_QUEUE_SIZE> client;
+    ShmRing<PremiumRequest, PREMIUM_QUEUE_SIZE> premium;
+};
+
+// ============================================================================
+// GROUP REGISTRY (GROUP_MAILBOXES)
+// ============================================================================
+
+// One entry per live group. The service writes a seating reply into the
+// entry and wakes only its owner, instead of every waiting group sharing
+// serviceQid and the kernel filtering the list by mtype. It also records
+// where the group sits, so departure frees the slot without a table scan.
+// A group that was seated hands its entry to the service with
+// REQ_GROUP_FINISHED; the service releases it after the departure.
+struct GroupEntry {
+    pid_t owner;            // 0 if the entry is free (claimed with CAS)
+    int groupID;
+    int full;               // 1 while a reply is waiting to be read
+    ServiceRequest reply;
+    ShmEvent ready;         // Bumped when the reply is written
+    int table;              // Seat of the group (service only), -1 if none
+    int slot;
+};
+
+struct GroupRegistry {
+    GroupEntry entry[GROUP_REGISTRY_SIZE];
+};
+
 
 // ============================================================================
 // GLOBAL IPC HANDLES
@@ -92,6 +149,23 @@ extern int semId;
 extern int msgId;
 extern RestaurantState* state;
 
+// Futex semaphore: value is the count (the futex word), waiters the number
+// of processes parked on it, so V() only enters the kernel when needed
+struct FutexSem {
+    int value;
+    int waiters;
+};
+
+// SEM_COUNT futex semaphores, placed in the shared segment right after
+// RestaurantState (FUTEX_SEMAPHORES only)
+extern FutexSem* semTable;
+
+// Request rings, after the semaphores (SHM_QUEUES only)
+extern MsgRings* msgRings;
+
+// Group registry, after the rings (GROUP_MAILBOXES only)
+extern GroupRegistry* groupRegistry;
+
 extern int fifoFdWrite;
 extern int fifoFdRead;
 
@@ -113,15 +187,33 @@ void ipcCleanup();
 // P (Wait/Decrement) Operation on Semaphore
 void P(int semnum);
 
+// Non-blocking P, false if the semaphore is at zero
+bool tryP(int semnum);
+
 // V (Signal/Increment) Operation on Semaphore
 void V(int semnum);
 
 // Get current value of semaphore (safe/non-blocking)
 int getSemValue(int semnum);
 
+// Sleeps until ev->seq moves past seen, for at most timeoutNs
+void eventWait(ShmEvent* ev, int seen, long long timeoutNs = 500000000LL);
 
-// Pushes a group into the waiting queue (VIP or Normal)
-bool queuePush(pid_t groupPid, bool vipStatus, int groupSize, int groupID);
+// Wakes every sleeper of ev; no syscall if nobody waits
+void eventNotify(ShmEvent* ev);
+
+// Set semaphore value (initialization only)
+void semSet(int semnum, int val);
+
+
+// Waiting queues (SEM_MUTEX_QUEUE held for queueRemove); the groups of size
+// k are visited oldest first with for (i = q.head[k]; i != -1; i = q.next[i])
+void queueInit(GroupQueue& q);
+void queueRemove(GroupQueue& q, int node);
+
+// Pushes a group into the waiting queue (VIP or Normal); it expires after
+// patienceMs (0 = never), at the time stored in expireNs
+bool queuePush(pid_t groupPid, bool vipStatus, int groupSize, int groupID, int mailbox, int patienceMs, long long& expireNs);
 
 // Create Message Queue with specified Project ID
 int createQueue(char projId);
@@ -134,10 +226,14 @@ void removeQueue(char projId);
 
 
 // --- Safe Message Queue Wrappers ---
-// These wrappers handle retries, termination flags, and flow control (semaphores)
+// These wrappers handle retries, termination flags, and flow control
+// (semaphores, or ring capacity for the SHM_QUEUES rings, which are FIFO
+// and ignore mtype)
 
 void queueSendRequest(const ClientRequest& msg);
 void queueRecvRequest(ClientRequest& msg, long mtype = 0);
+bool queueTryRecvRequest(ClientRequest& msg); // Non-blocking, any mtype
+bool queueRecvRequestUntil(ClientRequest& msg, long long deadlineNs); // false at the monotonic deadline
 void queueSendResponse(const ClientResponse& msg);
 void queueRecvResponse(ClientResponse& msg, long mtype = 0);
 
@@ -147,6 +243,21 @@ void queueRecvRequest(ServiceRequest& msg, long mtype = 0);
 void queueSendRequest(const PremiumRequest& msg);
 bool queueRecvRequest(PremiumRequest& msg, long mtype = 0);
 
+// Free capacity of the client request queue (admission throttle)
+int clientQueueFree();
+
+// Seating replies. groupMailboxOpen claims a registry entry for a group
+// (-1 without GROUP_MAILBOXES: replies then travel over serviceQid, mtype=pid)
+int groupMailboxOpen(pid_t pid, int groupID);
+void groupMailboxClose(int mailbox);
+void groupReplySend(int mailbox, const ServiceRequest& msg); // msg.mtype = group pid
+void groupReplyRecv(int mailbox, pid_t pid, ServiceRequest& msg); // pid = mtype without mailboxes
+
+// Seat registry (service, SEM_MUTEX_STATE held). groupFindSeat fails if the
+// entry does not belong to groupID or holds no seat; callers then scan.
+void groupRecordSeat(int mailbox, int table, int slot);
+bool groupFindSeat(int mailbox, int groupID, int& table, int& slot);
+
 
 // --- FIFO Logging ---
 
@@ -5,6 +5,7 @@
 #include "client.h"
 #include "belt.h"
 #include "reports.h"
+#include "seating.h"
 
 volatile sig_atomic_t terminate_flag = 0;
 volatile sig_atomic_t evacuate_flag = 0;
@@ -20,7 +21,15 @@ void evacuationHandler(int sig) {
     evacuate_flag = 1;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && !seatingPolicySelect(argv[1])) {
+        fprintf(stderr, "Unknown seating policy '%s'. Available:", argv[1]);
+        for (int p = 0; p < seatingPolicyCount; ++p)
+            fprintf(stderr, " %s", seatingPolicies[p].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
     struct sigaction sa = { 0 };
 
     sa.sa_handler = sigintHandler;
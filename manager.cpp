@@ -1,4 +1,6 @@
 ﻿#include "manager.h"
+#include "belt.h"
+#include "seating.h"
 
 volatile sig_atomic_t managerCmd = 0;
 
@@ -29,6 +31,9 @@ void startManager() {
     state->restaurantMode = OPEN;
     state->simulationSpeed = SPEED_NORMAL;
     state->nextDishID = 1;
+#if !BELT_LOCKFREE
+    beltInitIndex(state);
+#endif
 
     for (int i = 0; i < TABLE_COUNT; ++i) {
         Table& t = state->tables[i];
@@ -51,6 +56,7 @@ void startManager() {
             t.slots[s].vipStatus = false;
         }
     }
+    seatIndexInit(state);
 
     V(SEM_MUTEX_STATE);
 
@@ -1,5 +1,9 @@
 ﻿#include "reports.h"
 #include "ipc_manager.h"
+#include "belt.h"
+#include "seating.h"
+
+#include <pthread.h>
 
 // Prints the total production report (Chef)
 void printChefReport(RestaurantState* state) {
@@ -59,15 +63,13 @@ void printServiceReport(RestaurantState* state) {
     int totalRemaining = 0;
     int totalRemainingValue = 0;
     
-    for (int i = 0; i < BELT_SIZE; ++i) {
-        Dish& d = state->belt[i];
-        if (d.dishID != 0) {
-            int colorIdx = colorToIndex(d.color);
-            remainingByColor[colorIdx]++;
-            remainingValue[colorIdx] += d.price;
-            totalRemaining++;
-            totalRemainingValue += d.price;
-        }
+    for (int i = beltNextOccupied(state, 0); i != -1; i = beltNextOccupied(state, i + 1)) {
+        Dish d = beltGet(state, i);
+        int colorIdx = colorToIndex(d.color);
+        remainingByColor[colorIdx]++;
+        remainingValue[colorIdx] += d.price;
+        totalRemaining++;
+        totalRemainingValue += d.price;
     }
     
     for (int i = 0; i < COLOR_COUNT; ++i) {
@@ -112,6 +114,144 @@ void printWastedReport(RestaurantState* state) {
     printf("====================================\n\n");
 }
 
+// Prints premium order-to-delivery times
+void printPremiumReport(RestaurantState* state) {
+    printf("\n========== PREMIUM REPORT ==========\n");
+    printf("Placement: %s\n", PREMIUM_ROUTING ? "routed to the table window" : "first free slot");
+    printf("Ordered:   %d\n", state->premiumOrdered);
+    printf("Delivered: %d\n", state->premiumDelivered);
+
+    if (state->premiumDelivered > 0) {
+        printf("Time to delivery: avg %.3f ms, max %.3f ms\n",
+            state->premiumDeliveryNs / 1e6 / state->premiumDelivered,
+            state->premiumDeliveryMaxNs / 1e6);
+    }
+    printf("====================================\n\n");
+}
+
+// Upper edge in ms of the bucket holding the p-th percentile wait
+static int waitPercentileMs(const int hist[WAIT_HIST_BUCKETS], int total, double p) {
+    int rank = (int)(p * total + 0.999999);
+    int seen = 0;
+    for (int b = 0; b < WAIT_HIST_BUCKETS; ++b) {
+        seen += hist[b];
+        if (seen >= rank) return (b + 1) * WAIT_HIST_STEP_MS;
+    }
+    return WAIT_HIST_BUCKETS * WAIT_HIST_STEP_MS;
+}
+
+// Prints seating utilization and waits
+void printSeatingReport(RestaurantState* state) {
+    printf("\n========== SEATING REPORT ==========\n");
+    printf("Policy: %s%s%s\n", seatingPolicy.name,
+        INCREMENTAL_SEATING ? ", incremental passes" : ", full passes",
+        VIP_AGING ? ", VIP aging" : ", VIPs first");
+    printf("Groups seated: %d\n", state->groupsSeated);
+
+    if (state->groupsSeated > 0) {
+        printf("Wait for a table: avg %.3f ms, max %.3f ms\n",
+            state->seatWaitNs / 1e6 / state->groupsSeated,
+            state->seatWaitMaxNs / 1e6);
+    }
+
+    static const char* classes[] = { "Normal", "VIP" };
+    for (int v = 1; v >= 0; --v) {
+        int total = 0;
+        for (int b = 0; b < WAIT_HIST_BUCKETS; ++b)
+            total += state->seatWaitHist[v][b];
+        if (total == 0) continue;
+
+        printf("%s wait (%d groups): p50 <%d ms, p90 <%d ms, p99 <%d ms\n", classes[v], total,
+            waitPercentileMs(state->seatWaitHist[v], total, 0.50),
+            waitPercentileMs(state->seatWaitHist[v], total, 0.90),
+            waitPercentileMs(state->seatWaitHist[v], total, 0.99));
+    }
+
+    long long spanNs = state->seatClockLastNs - state->seatClockStartNs;
+    if (spanNs > 0) {
+        printf("Seat utilization: %.1f%% of %d seats over %.3f s\n",
+            100.0 * state->occupiedSeatNs / ((double)spanNs * TOTAL_SEATS),
+            TOTAL_SEATS, spanNs / 1e9);
+    }
+    printf("====================================\n\n");
+}
+
+// Prints the groups that left the queue before getting a table
+void printLostCustomersReport(RestaurantState* state) {
+    int groups = state->groupsLost[0] + state->groupsLost[1];
+
+    printf("\n======= LOST CUSTOMERS REPORT ======\n");
+    if (GROUP_PATIENCE_MS > 0)
+        printf("Patience: %d-%d ms per group\n", GROUP_PATIENCE_MS / 2, GROUP_PATIENCE_MS * 3 / 2);
+    else
+        printf("Patience: unlimited\n");
+    printf("Groups lost: %d (VIP %d, normal %d)\n", groups, state->groupsLost[1], state->groupsLost[0]);
+    printf("People lost: %d (VIP %d, normal %d)\n",
+        state->peopleLost[0] + state->peopleLost[1], state->peopleLost[1], state->peopleLost[0]);
+
+    if (groups > 0) {
+        printf("Share of groups lost: %.1f%%\n",
+            100.0 * groups / (groups + state->groupsSeated));
+        printf("Average wait before leaving: %.3f ms\n", state->lostWaitNs / 1e6 / groups);
+    }
+    printf("====================================\n\n");
+}
+
+// Prints how fast group processes were created and how many ran at once
+void printGroupCreationReport(RestaurantState* state) {
+    int groups = state->totalGroupsCreated;
+    double spanMs = (state->groupCreateLastNs - state->groupCreateFirstNs) / 1e6;
+
+    printf("\n======= GROUP CREATION REPORT ======\n");
+    if (GROUP_WORKERS > 0)
+        printf("Mode: pool of %d pre-forked workers\n", GROUP_WORKERS);
+    else
+        printf("Mode: fork per group\n");
+    printf("Groups created: %d in %.3f ms\n", groups, spanMs);
+    if (groups > 1 && spanMs > 0)
+        printf("Creation rate: %.0f groups/s\n", (groups - 1) * 1000.0 / spanMs);
+    printf("Peak group processes: %d\n", state->groupProcsPeak);
+    printf("Peak live groups: %d\n", state->groupsLivePeak);
+    printf("====================================\n\n");
+}
+
+// Prints how the guests ran: context switches, window scans and memory
+void printPersonReport(RestaurantState* state) {
+    long long dishes = 0;
+    for (int i = 0; i < COLOR_COUNT; ++i)
+        dishes += state->soldCount[i];
+    long long csw = state->personCswVoluntary + state->personCswInvoluntary;
+
+    printf("\n======= PERSON EXECUTION REPORT ====\n");
+    if (PERSON_FIBERS) {
+        printf("Mode: fibers, %d KB stack per guest\n", PERSON_FIBER_STACK / 1024);
+    } else {
+        pthread_attr_t attr;
+        size_t stack = 0;
+        pthread_attr_init(&attr);
+        pthread_attr_getstacksize(&attr, &stack);
+        pthread_attr_destroy(&attr);
+        printf("Mode: thread per guest, %zu KB stack per guest\n", stack / 1024);
+    }
+    printf("Context switches: %lld (voluntary %lld, involuntary %lld)\n",
+        csw, state->personCswVoluntary, state->personCswInvoluntary);
+    if (dishes > 0)
+        printf("Context switches per consumed dish: %.2f\n", (double)csw / dishes);
+    printf("Waiting for dishes: %s\n", DISH_NOTIFY ? "window events" : "yield and rescan");
+    printf("Scanning: %s\n", GROUP_SCANNER ? "one scanner per group" : "every person");
+    printf("Window scans: %lld, wasted %lld", state->beltWindowScans, state->beltScansWasted);
+    if (dishes > 0)
+        printf(" (%.2f and %.2f per consumed dish)",
+            (double)state->beltWindowScans / dishes, (double)state->beltScansWasted / dishes);
+    printf("\n");
+    if (state->groupRssGuests > 0)
+        printf("Group process peak RSS per seated guest: %.1f KB\n",
+            (double)state->groupRssKb / state->groupRssGuests);
+    else if (GROUP_WORKERS > 0)
+        printf("Worker peak RSS: %lld KB over %d workers\n", state->groupRssKb, GROUP_WORKERS);
+    printf("====================================\n\n");
+}
+
 // Orchestrates the printing of all final reports and performs data validation
 void printAllReports(RestaurantState* state) {
     printf("\n\n");
@@ -123,6 +263,11 @@ void printAllReports(RestaurantState* state) {
     printCashierReport(state);
     printServiceReport(state);
     printWastedReport(state);
+    printPremiumReport(state);
+    printSeatingReport(state);
+    printLostCustomersReport(state);
+    printGroupCreationReport(state);
+    printPersonReport(state);
     
     // Validation check: Conservation of Mass/Value
     int totalProduced = 0;
@@ -136,9 +281,7 @@ void printAllReports(RestaurantState* state) {
         totalWasted += state->wastedCount[i];
     }
     
-    for (int i = 0; i < BELT_SIZE; ++i) {
-        if (state->belt[i].dishID != 0) totalRemaining++;
-    }
+    totalRemaining = beltPopcount(state);
     
     printf("\n========== VALIDATION ==========\n");
     printf("Produced: %d\n", totalProduced);
@@ -5,4 +5,9 @@ void printChefReport(RestaurantState* state);
 void printCashierReport(RestaurantState* state);
 void printServiceReport(RestaurantState* state);
 void printWastedReport(RestaurantState* state);
+void printPremiumReport(RestaurantState* state);
+void printSeatingReport(RestaurantState* state);
+void printLostCustomersReport(RestaurantState* state);
+void printGroupCreationReport(RestaurantState* state);
+void printPersonReport(RestaurantState* state);
 void printAllReports(RestaurantState* state);
@@ -0,0 +1,343 @@
+﻿#include "seating.h"
+
+static_assert(SEAT_BUCKETS <= 64, "seat buckets must fit the bucket mask");
+
+static int seatKey(int freeSeats, int occupantClass, bool vipEligible) {
+    return (freeSeats * SEAT_CLASSES + occupantClass) * 2 + (vipEligible ? 1 : 0);
+}
+
+static int occupantClass(const Table& t) {
+    int cls = 0;
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+        if (t.slots[s].pid == -1) continue;
+        if (cls == 0)
+            cls = t.slots[s].size;
+        else if (t.slots[s].size != cls)
+            return SEAT_CLASS_MIXED;
+    }
+    return cls;
+}
+
+static int tableKey(const Table& t) {
+    return seatKey(t.capacity - t.occupiedSeats, occupantClass(t), t.capacity > 1);
+}
+
+static void unlink(RestaurantState* state, int table) {
+    int key = state->seatKey[table];
+    int next = state->seatNext[table];
+    int prev = state->seatPrev[table];
+
+    if (prev != -1) state->seatNext[prev] = next;
+    else state->seatHead[key] = next;
+    if (next != -1) state->seatPrev[next] = prev;
+    if (state->seatHead[key] == -1)
+        state->seatBucketMask &= ~(1ULL << key);
+}
+
+static void link(RestaurantState* state, int table, int key) {
+    int head = state->seatHead[key];
+
+    state->seatKey[table] = key;
+    state->seatNext[table] = head;
+    state->seatPrev[table] = -1;
+    if (head != -1) state->seatPrev[head] = table;
+    state->seatHead[key] = table;
+    state->seatBucketMask |= 1ULL << key;
+}
+
+void seatIndexInit(RestaurantState* state) {
+    state->seatBucketMask = 0;
+    for (int b = 0; b < SEAT_BUCKETS; ++b)
+        state->seatHead[b] = -1;
+
+    // Linked in reverse so each bucket lists its tables in table order
+    for (int i = TABLE_COUNT - 1; i >= 0; --i)
+        link(state, i, tableKey(state->tables[i]));
+}
+
+void seatIndexUpdate(RestaurantState* state, int table) {
+    int key = tableKey(state->tables[table]);
+    if (key == state->seatKey[table]) return;
+
+    unlink(state, table);
+    link(state, table, key);
+}
+
+// Buckets a group of the given size and VIP status may sit in
+static uint64_t acceptMask(bool vipStatus, int groupSize) {
+    static uint64_t masks[2][MAX_TABLE_SLOTS + 1];
+    static bool ready = false;
+
+    if (!ready) {
+        for (int vip = 0; vip < 2; ++vip) {
+            for (int k = 1; k <= MAX_TABLE_SLOTS; ++k) {
+                uint64_t m = 0;
+                for (int f = k; f <= MAX_TABLE_SLOTS; ++f) {
+                    for (int cls = 0; cls < SEAT_CLASS_MIXED; ++cls) {
+#if TABLE_SHARING_TEST
+                        if (cls != 0 && cls != k) continue;
+#endif
+                        m |= 1ULL << seatKey(f, cls, true);
+                        if (!vip) m |= 1ULL << seatKey(f, cls, false);
+                    }
+                }
+                masks[vip][k] = m;
+            }
+        }
+        ready = true;
+    }
+    return masks[vipStatus ? 1 : 0][groupSize];
+}
+
+bool tableFits(const Table& t, bool vipStatus, int groupSize) {
+    if (vipStatus && t.capacity == 1) return false;
+    if (t.capacity - t.occupiedSeats < groupSize) return false;
+
+    int cls = occupantClass(t);
+    if (cls == SEAT_CLASS_MIXED) return false;
+#if TABLE_SHARING_TEST
+    if (cls != 0 && cls != groupSize) return false;
+#endif
+    return true;
+}
+
+int seatPackTable(const Table& t, const int avail[MAX_GROUP_SIZE + 1], int out[MAX_TABLE_SLOTS]) {
+    int freeSeats = t.capacity - t.occupiedSeats;
+    int cls = occupantClass(t);
+    if (freeSeats <= 0 || cls == SEAT_CLASS_MIXED) return 0;
+
+    int freeSlots = 0;
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s)
+        if (t.slots[s].pid == -1) freeSlots++;
+
+    int bestA = 0, bestM = 0, bestB = 0;
+    int bestFill = 0, bestLargest = 0, bestGroups = 0;
+
+    // m groups of size a keep the table single-size, b is the optional last join
+    for (int a = 1; a <= MAX_GROUP_SIZE; ++a) {
+        int maxM = (cls == 0 || cls == a) ? avail[a] : 0;
+        if (maxM > freeSeats / a) maxM = freeSeats / a;
+        if (maxM > freeSlots) maxM = freeSlots;
+
+        for (int m = 0; m <= maxM; ++m) {
+            for (int b = 0; b <= MAX_GROUP_SIZE; ++b) {
+                if (b > 0) {
+                    if (m > 0 && b == a) continue; // Same as m + 1 groups of a
+                    if (avail[b] < 1 || m + 1 > freeSlots) continue;
+#if TABLE_SHARING_TEST
+                    int single = cls != 0 ? cls : (m > 0 ? a : b);
+                    if (b != single) continue;
+#endif
+                }
+
+                int fill = m * a + b;
+                if (fill == 0 || fill > freeSeats) continue;
+
+                int largest = b > (m > 0 ? a : 0) ? b : (m > 0 ? a : 0);
+                int groups = m + (b > 0 ? 1 : 0);
+                if (fill > bestFill
+                    || (fill == bestFill && largest > bestLargest)
+                    || (fill == bestFill && largest == bestLargest && groups < bestGroups)) {
+                    bestA = a; bestM = m; bestB = b;
+                    bestFill = fill; bestLargest = largest; bestGroups = groups;
+                }
+            }
+        }
+    }
+
+    int n = 0;
+    for (int k = 0; k < bestM; ++k)
+        out[n++] = bestA;
+    if (bestB > 0)
+        out[n++] = bestB;
+    return n;
+}
+
+int seatIndexFind(const RestaurantState* state, bool vipStatus, int groupSize) {
+    if (groupSize < 1 || groupSize > MAX_TABLE_SLOTS) return -1;
+
+    uint64_t hits = state->seatBucketMask & acceptMask(vipStatus, groupSize);
+    if (hits == 0) return -1;
+    return state->seatHead[__builtin_ctzll(hits)];
+}
+
+// Indexed by SEATING_POLICY for the first three
+const SeatingPolicy seatingPolicies[] = {
+    { "first-fit", SEAT_FIT_FIRST, true, 0 },
+    { "best-fit", SEAT_FIT_BEST, true, 0 },
+    { "bin-pack", SEAT_FIT_PACK, true, 0 },
+    { "worst-fit", SEAT_FIT_WORST, true, 0 },
+    { "vip-reserve", SEAT_FIT_BEST, true, VIP_RESERVE_SEATS },
+    { "fifo", SEAT_FIT_BEST, false, 0 },
+};
+const int seatingPolicyCount = sizeof(seatingPolicies) / sizeof(seatingPolicies[0]);
+
+static_assert(SEATING_POLICY >= 0 && SEATING_POLICY < 3, "SEATING_POLICY names a built-in policy");
+SeatingPolicy seatingPolicy = seatingPolicies[SEATING_POLICY];
+
+bool seatingPolicySelect(const char* name) {
+    for (int p = 0; p < seatingPolicyCount; ++p) {
+        if (strcmp(seatingPolicies[p].name, name) == 0) {
+            seatingPolicy = seatingPolicies[p];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether a group taking `seats` more seats leaves the VIP reserve free
+static bool reserveAllows(const RestaurantState* state, bool vipStatus, int seats) {
+    return vipStatus || TOTAL_SEATS - state->currentGuestCount - seats >= seatingPolicy.vipReserve;
+}
+
+int seatFindTable(const RestaurantState* state, bool vipStatus, int groupSize) {
+    if (groupSize < 1 || groupSize > MAX_TABLE_SLOTS) return -1;
+    if (!reserveAllows(state, vipStatus, groupSize)) return -1;
+
+    if (seatingPolicy.fit == SEAT_FIT_FIRST) {
+        for (int i = 0; i < TABLE_COUNT; ++i)
+            if (tableFits(state->tables[i], vipStatus, groupSize)) return i;
+        return -1;
+    }
+    if (seatingPolicy.fit == SEAT_FIT_WORST) {
+        uint64_t hits = state->seatBucketMask & acceptMask(vipStatus, groupSize);
+        if (hits == 0) return -1;
+        return state->seatHead[63 - __builtin_clzll(hits)];
+    }
+    return seatIndexFind(state, vipStatus, groupSize);
+}
+
+// Scheduling key of a queued group, smaller goes first
+static long long queueKey(const GroupQueue& q, bool vip, int node) {
+#if VIP_AGING
+    return q.queuedNs[node] + (vip ? 0 : VIP_PRIORITY_BOOST_MS * 1000000LL);
+#else
+    return (vip ? 0 : 1LL << 40) + q.seq[node];
+#endif
+}
+
+// Oldest group of the queue the policy can seat now, at table if given.
+// Strict FIFO only ever seats the oldest group, wherever it fits, so it
+// ignores the table hint.
+static int pickHead(const RestaurantState* state, const GroupQueue& q, bool vip,
+    int table, int& at, int& checks) {
+    int heads[MAX_GROUP_SIZE];
+    int n = 0;
+    for (int k = 1; k <= MAX_GROUP_SIZE; ++k) {
+        int node = q.head[k];
+        if (node == -1) continue;
+
+        int j = n++;
+        while (j > 0 && q.seq[heads[j - 1]] > q.seq[node]) {
+            heads[j] = heads[j - 1];
+            --j;
+        }
+        heads[j] = node;
+    }
+    if (!seatingPolicy.skipAhead && n > 1) n = 1;
+
+    for (int h = 0; h < n; ++h) {
+        int size = q.groupSize[heads[h]];
+        checks++;
+        if (seatingPolicy.skipAhead && table != -1 && !tableFits(state->tables[table], vip, size))
+            continue;
+
+        at = seatFindTable(state, vip, size);
+        if (at != -1) return heads[h];
+    }
+    return -1;
+}
+
+// Best packing of the waiting groups into table, taking the oldest of each
+// size from the queue whose head goes first. An overdue group that fits is
+// seated first and the rest of the table packed around it.
+static int pickPacked(const RestaurantState* state, int table, bool normalAllowed,
+    long long nowNs, SeatPick out[MAX_TABLE_SLOTS], int& checks) {
+    Table t = state->tables[table];
+    const GroupQueue* queues[2] = { &state->normalQueue, &state->vipQueue };
+    bool allowed[2] = { normalAllowed, t.capacity > 1 };
+
+    int avail[MAX_GROUP_SIZE + 1] = { 0 };
+    int cursor[2][MAX_GROUP_SIZE + 1];
+    for (int v = 0; v < 2; ++v) {
+        for (int k = 1; k <= MAX_GROUP_SIZE; ++k) {
+            cursor[v][k] = allowed[v] ? queues[v]->head[k] : -1;
+            if (allowed[v]) avail[k] += queues[v]->sizeCount[k];
+        }
+    }
+
+    int n = 0, seats = 0;
+#if VIP_AGING
+    int urgentV = -1, urgentK = 0;
+    long long urgentKey = 0;
+    for (int v = 0; v < 2; ++v) {
+        for (int k = 1; k <= MAX_GROUP_SIZE; ++k) {
+            int node = cursor[v][k];
+            if (node == -1 || !tableFits(t, v == 1, k)) continue;
+
+            long long key = queueKey(*queues[v], v == 1, node);
+            if (urgentV == -1 || key < urgentKey) {
+                urgentV = v; urgentK = k; urgentKey = key;
+            }
+        }
+    }
+
+    if (urgentV != -1 && nowNs - urgentKey > SEAT_OVERDUE_MS * 1000000LL
+        && reserveAllows(state, urgentV == 1, urgentK)) {
+        int node = cursor[urgentV][urgentK];
+        cursor[urgentV][urgentK] = queues[urgentV]->next[node];
+        avail[urgentK]--;
+        out[n++] = { node, urgentV == 1, table };
+        seats += urgentK;
+
+        // Pack the rest as if it were already seated
+        for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+            if (t.slots[s].pid != -1) continue;
+            t.slots[s].pid = 0;
+            t.slots[s].size = urgentK;
+            break;
+        }
+        t.occupiedSeats += urgentK;
+    }
+#endif
+
+    int sizes[MAX_TABLE_SLOTS];
+    int count = seatPackTable(t, avail, sizes);
+    checks += MAX_GROUP_SIZE;
+
+    for (int j = 0; j < count && n < MAX_TABLE_SLOTS; ++j) {
+        int k = sizes[j];
+        int v = cursor[1][k] != -1 ? 1 : 0;
+        if (v == 1 && cursor[0][k] != -1
+            && queueKey(*queues[0], false, cursor[0][k]) < queueKey(*queues[1], true, cursor[1][k]))
+            v = 0;
+        int node = cursor[v][k];
+        if (node == -1 || !reserveAllows(state, v == 1, seats + k)) break;
+
+        cursor[v][k] = queues[v]->next[node];
+        out[n++] = { node, v == 1, table };
+        seats += k;
+    }
+    return n;
+}
+
+int seatPickQueued(const RestaurantState* state, int table, bool normalAllowed,
+    long long nowNs, SeatPick out[MAX_TABLE_SLOTS], int& checks) {
+    if (seatingPolicy.fit == SEAT_FIT_PACK)
+        return table == -1 ? 0 : pickPacked(state, table, normalAllowed, nowNs, out, checks);
+
+    int vipAt = -1, normalAt = -1;
+    int vipNode = pickHead(state, state->vipQueue, true, table, vipAt, checks);
+    int normalNode = normalAllowed ? pickHead(state, state->normalQueue, false, table, normalAt, checks) : -1;
+
+    if (vipNode != -1 && (normalNode == -1
+        || queueKey(state->vipQueue, true, vipNode) <= queueKey(state->normalQueue, false, normalNode))) {
+        out[0] = { vipNode, true, vipAt };
+        return 1;
+    }
+    if (normalNode != -1) {
+        out[0] = { normalNode, false, normalAt };
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include "ipc_manager.h"
+
+// Free-capacity index: every table sits in the bucket of its seat key
+// (free seats, occupant class, VIP eligibility). A group of size k can sit
+// at any table with at least k free seats whose occupants all share one
+// size, so the acceptable buckets form a fixed mask per (k, VIP) and a
+// lookup is one AND plus a count-trailing-zeros.
+// All functions expect SEM_MUTEX_STATE held.
+
+// Occupant classes: 0 = empty, 1..MAX_TABLE_SLOTS = all groups of that size
+#define SEAT_CLASS_MIXED (MAX_TABLE_SLOTS + 1)
+
+void seatIndexInit(RestaurantState* state);
+
+// Re-buckets a table after its occupants changed
+void seatIndexUpdate(RestaurantState* state, int table);
+
+// Returns a table the group fits at (fewest free seats first), or -1
+int seatIndexFind(const RestaurantState* state, bool vipStatus, int groupSize);
+
+// Whether the group may join table t (the rule both policies apply)
+bool tableFits(const Table& t, bool vipStatus, int groupSize);
+
+// Bin packing for one table (SEATING_BIN_PACK): picks the group sizes that
+// fill the most free seats given avail[k] waiting groups of size k, in the
+// order they must be seated so each join passes tableFits. A table stays
+// single-size until its last join, so a fill is m groups of one size plus
+// at most one other. Ties go to larger groups, which fit fewer tables.
+// Returns the number of sizes written to out.
+int seatPackTable(const Table& t, const int avail[MAX_GROUP_SIZE + 1], int out[MAX_TABLE_SLOTS]);
+
+// Seating policies, picked at startup (./restauracja <policy>, default
+// SEATING_POLICY). The service only locks, seats and replies; every choice
+// of table and of the queued group to seat next is made here.
+#define SEAT_FIT_FIRST 0 // Lowest-numbered table the group fits at
+#define SEAT_FIT_BEST 1  // Table left with the fewest free seats
+#define SEAT_FIT_WORST 2 // Table left with the most free seats
+#define SEAT_FIT_PACK 3  // Best fit on arrival, queued groups bin-packed per table
+
+// Free seats normal groups leave for VIPs under the vip-reserve policy
+#define VIP_RESERVE_SEATS 8
+
+struct SeatingPolicy {
+    const char* name;
+    int fit;        // SEAT_FIT_*
+    bool skipAhead; // A queued group may pass an older one that cannot sit yet
+    int vipReserve; // Free seats normal groups must leave for VIPs
+};
+
+extern const SeatingPolicy seatingPolicies[];
+extern const int seatingPolicyCount;
+extern SeatingPolicy seatingPolicy; // The policy in use
+
+// Switches to the named policy; false if there is none
+bool seatingPolicySelect(const char* name);
+
+// Returns the table the policy seats an arriving group at, or -1
+int seatFindTable(const RestaurantState* state, bool vipStatus, int groupSize);
+
+// A queued group chosen by a seating pass
+struct SeatPick {
+    int node; // Node in its queue
+    bool vip; // Which queue: VIP or normal
+    int table;
+};
+
+// Picks queued groups to seat for a pass over table (-1 = any table;
+// bin-pack needs a table), earliest deadline first (see VIP_AGING), normal
+// groups only if normalAllowed. nowNs is on the queuedNs clock. Each pick is
+// valid once the previous ones are seated. checks counts the queued groups
+// looked at. Expects SEM_MUTEX_QUEUE held as well.
+int seatPickQueued(const RestaurantState* state, int table, bool normalAllowed,
+    long long nowNs, SeatPick out[MAX_TABLE_SLOTS], int& checks);
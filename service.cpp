@@ -1,194 +1,268 @@
 ﻿#include "service.h"
+#include "belt.h"
+#include "seating.h"
 
 // Removes abandoned dishes from the belt if a group leaves prematurely
+#if BELT_LOCKFREE
 static void cleanZombieDishes(RestaurantState* state, int groupID) {
-    for (int i = 0; i < BELT_SIZE; ++i) {
-        Dish& d = state->belt[i];
-        if (d.dishID == 0) continue;
-        if (d.targetGroupID == groupID) {
-            int colorIdx = colorToIndex(d.color);
+    for (int i = 0; i < BELT_SIZE && beltItems(state) > 0; ++i) {
+        Dish d;
+        if (!beltClaimTargeted(state, i, groupID, d)) continue;
+
+        int colorIdx = colorToIndex(d.color);
+        state->wastedCount[colorIdx]++;
+        state->wastedValue[colorIdx] += d.price;
+
+        beltReleaseClaim(state);
+    }
+}
+#else
+// Visits only the group's own dishes through the targeted dish index
+static void cleanZombieDishes(RestaurantState* state, int groupID) {
+    int slots[BELT_SIZE];
+    int count = beltTargetedSlots(state, groupID, slots, BELT_SIZE);
+
+    for (int k = 0; k < count; ++k) {
+        int i = slots[k];
+        int seg = beltSegmentOf(i);
+        beltLockSegment(seg);
+
+        // The dish may have been eaten since the snapshot
+        if (beltIsOccupied(state, i) && state->belt.targetGroupID[i] == groupID) {
+            int colorIdx = colorToIndex(state->belt.color[i]);
             state->wastedCount[colorIdx]++;
-            state->wastedValue[colorIdx] += d.price;
+            state->wastedValue[colorIdx] += state->belt.price[i];
 
-            d.dishID = 0;
-            d.targetGroupID = -1;
+            beltTake(state, i);
             V(SEM_BELT_SLOTS);
         }
+
+        beltUnlockSegment(seg);
     }
 }
+#endif
 
 static int zombieTestOccupancy = 0;
 static bool zombieGroupFinished = false;
 
-// Tries to find a suitable table for a group
-// Returns table index or -1 if none found
-int assignTable(RestaurantState* state, bool vipStatus, int groupSize, int groupID, pid_t pid) {
-    for (int i = 0; i < TABLE_COUNT; ++i) {
-        P(SEM_MUTEX_STATE);
-        Table& t = state->tables[i];
+// Integrates occupied seats up to now; call before currentGuestCount changes
+static void tickSeatClock(RestaurantState* state) {
+    long long now = monotonicNs();
 
-        if (vipStatus && t.capacity == 1) {
-            V(SEM_MUTEX_STATE);
-            continue;
-        }
+    if (state->seatClockStartNs == 0)
+        state->seatClockStartNs = now;
+    else
+        state->occupiedSeatNs += state->currentGuestCount * (now - state->seatClockLastNs);
+    state->seatClockLastNs = now;
+}
 
-        int freeSeats = t.capacity - t.occupiedSeats;
-        if (freeSeats < groupSize) {
-            V(SEM_MUTEX_STATE);
-            continue;
-        }
+// Accounts the wait of a seated group (queuedNs 0 if seated on arrival)
+static void noteSeatWait(RestaurantState* state, long long queuedNs, bool vipStatus) {
+    long long wait = queuedNs > 0 ? monotonicNs() - queuedNs : 0;
 
-        // Logic check: Can we merge with existing occupants? 
-        // For simplicity: All groups at a table must be compatible (e.g., same size? No requirement in spec)
-        // Spec says: "Groups can share tables".
-        // Test IV: Mixing sizes. Ensure we don't start logical conflict.
-        
-        int referenceSize = -1;
-        bool compatible = true;
-
-        for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
-            if (t.slots[s].pid == -1) continue;
-            if (referenceSize == -1)
-                referenceSize = t.slots[s].size;
-            else if (t.slots[s].size != referenceSize) {
-                compatible = false;
-                break;
-            }
-        }
+    state->groupsSeated++;
+    state->seatWaitNs += wait;
+    if (wait > state->seatWaitMaxNs) state->seatWaitMaxNs = wait;
 
-#if TABLE_SHARING_TEST
-        if (referenceSize != -1 && referenceSize != groupSize)
-            compatible = false;
-#endif
+    long long bucket = wait / (WAIT_HIST_STEP_MS * 1000000LL);
+    if (bucket >= WAIT_HIST_BUCKETS) bucket = WAIT_HIST_BUCKETS - 1;
+    state->seatWaitHist[vipStatus ? 1 : 0][bucket]++;
+}
 
-        if (!compatible) {
-            V(SEM_MUTEX_STATE);
-            continue;
-        }
+// Puts the group into a free slot of table i (SEM_MUTEX_STATE held)
+static bool seatGroup(RestaurantState* state, int i, bool vipStatus, int groupSize, pid_t pid, int mailbox) {
+    Table& t = state->tables[i];
 
-        for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
-            if (t.slots[s].pid != -1) continue;
+    for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
+        if (t.slots[s].pid != -1) continue;
 
-            t.slots[s].pid = pid;
-            t.slots[s].size = groupSize;
-            t.slots[s].vipStatus = vipStatus;
+        t.slots[s].pid = pid;
+        t.slots[s].size = groupSize;
+        t.slots[s].vipStatus = vipStatus;
 
-            t.occupiedSeats += groupSize;
-            state->currentGuestCount += groupSize;
-            if (vipStatus) state->currentVIPCount++;
+        tickSeatClock(state);
+        t.occupiedSeats += groupSize;
+        state->currentGuestCount += groupSize;
+        if (vipStatus) state->currentVIPCount++;
 
-            V(SEM_MUTEX_STATE);
-            return i;
-        }
-
-        V(SEM_MUTEX_STATE);
+        seatIndexUpdate(state, i);
+        groupRecordSeat(mailbox, i, s);
+        return true;
     }
-    return -1;
+    return false;
 }
 
-void removeQueueItem(GroupQueue& q, int index) {
-    if (index < 0 || index >= q.count) return;
-    for (int i = index; i < q.count - 1; ++i) {
-        q.groupPid[i] = q.groupPid[i + 1];
-        q.groupSize[i] = q.groupSize[i + 1];
-        q.groupID[i] = q.groupID[i + 1];
-    }
-    q.count--;
+// Tries to find a suitable table for a group
+// Returns table index or -1 if none found
+int assignTable(RestaurantState* state, bool vipStatus, int groupSize, int groupID, pid_t pid, int mailbox) {
+    P(SEM_MUTEX_STATE);
+    int i = seatFindTable(state, vipStatus, groupSize);
+    if (i != -1 && !seatGroup(state, i, vipStatus, groupSize, pid, mailbox))
+        i = -1;
+    V(SEM_MUTEX_STATE);
+    return i;
 }
 
-// Attempts to assign waiting groups from the queue to tables
-// Called when a table frees up or admission gates open
-bool tryAssignFromQueue(
-    RestaurantState* state,
-    GroupQueue& queue,
-    bool isVip,
-    int semUsed,
-    int semFree,
-    bool allowZombieBlocking
-) {
-    int allocatedTable = -1;
-    int pid = -1, size = 0, gid = -1;
-
-    P(SEM_MUTEX_QUEUE);
-    for (int i = 0; i < queue.count; ++i) {
-        pid = queue.groupPid[i];
-        size = queue.groupSize[i];
-        gid = queue.groupID[i];
-
-#if PREDEFINED_ZOMBIE_TEST
-        if (allowZombieBlocking &&
-            !zombieGroupFinished && zombieTestOccupancy >= 1) {
-            break;
-        }
-#endif
-
-        allocatedTable = assignTable(state, isVip, size, gid, pid);
-        if (allocatedTable != -1) {
-            removeQueueItem(queue, i);
-            break;
-        }
-    }
-    V(SEM_MUTEX_QUEUE);
-
-    if (allocatedTable == -1)
-        return false;
+static int queueSeatChecks = 0; // Queued groups considered for a table
 
+// Releases the group's queue spot and sends it the table
+static void announceSeated(int table, pid_t pid, int gid, int size, bool isVip, int mailbox, int semFree) {
     V(semFree); // Release a spot in the queue backlog limiter
 
     char logBuffer[256];
     snprintf(logBuffer, sizeof(logBuffer),
         "\033[32m[%ld] [SERVICE]: QUEUE -> TABLE | tableID=%d pid=%d groupID=%d size=%d vipStatus=%d\033[0m",
-        time(NULL), allocatedTable, pid, gid, size, isVip);
+        time(NULL), table, pid, gid, size, isVip);
     fifoLog(logBuffer);
 
     ServiceRequest assigned{};
     assigned.mtype = pid;
     assigned.type = REQ_GROUP_ASSIGNED;
-    assigned.extraData = allocatedTable;
-    queueSendRequest(assigned);
+    assigned.extraData = table;
+    groupReplySend(mailbox, assigned);
+}
+
+// Seats the queued groups the policy picks for table (-1 = any table)
+// Returns false if nobody could be seated
+static bool seatQueued(RestaurantState* state, int table) {
+    struct Seated {
+        pid_t pid;
+        int gid;
+        int size;
+        int mailbox;
+        int table;
+        bool vip;
+    };
+    Seated seated[MAX_TABLE_SLOTS];
+    SeatPick picks[MAX_TABLE_SLOTS];
+
+    bool normalAllowed = true;
+#if PREDEFINED_ZOMBIE_TEST
+    if (!zombieGroupFinished && zombieTestOccupancy >= 1)
+        normalAllowed = false;
+#endif
+
+    P(SEM_MUTEX_QUEUE);
+    P(SEM_MUTEX_STATE);
+
+    int n = seatPickQueued(state, table, normalAllowed, monotonicNs(), picks, queueSeatChecks);
+    for (int j = 0; j < n; ++j) {
+        GroupQueue& q = picks[j].vip ? state->vipQueue : state->normalQueue;
+        int node = picks[j].node;
+
+        seated[j] = { q.groupPid[node], q.groupID[node], q.groupSize[node],
+            q.mailbox[node], picks[j].table, picks[j].vip };
+        noteSeatWait(state, q.queuedNs[node], picks[j].vip);
+        seatGroup(state, picks[j].table, picks[j].vip, q.groupSize[node], q.groupPid[node], q.mailbox[node]);
+        queueRemove(q, node);
+    }
+
+    V(SEM_MUTEX_STATE);
+    V(SEM_MUTEX_QUEUE);
 
-    return true;
+    for (int j = 0; j < n; ++j) {
+        const Seated& g = seated[j];
+        announceSeated(g.table, g.pid, g.gid, g.size, g.vip, g.mailbox,
+            g.vip ? SEM_QUEUE_FREE_VIP : SEM_QUEUE_FREE_NORMAL);
+    }
+    return n > 0;
+}
+
+static bool seatingPassPending = false;
+static int seatingPasses = 0;
+static int handledRequests = 0;
+
+#if INCREMENTAL_SEATING
+// Tables whose free capacity changed since the last seating pass
+static bool tableDirty[TABLE_COUNT];
+static int dirtyTables[TABLE_COUNT];
+static int dirtyCount = 0;
+
+static void markTableDirty(int table) {
+    if (tableDirty[table]) return;
+    tableDirty[table] = true;
+    dirtyTables[dirtyCount++] = table;
+}
+#endif
+
+// Handlers only record where capacity changed (table, or -1 for all);
+// the service loop runs one seating pass per drained batch
+static void requestSeatingPass(int table) {
+#if INCREMENTAL_SEATING
+    if (table == -1) {
+        for (int i = 0; i < TABLE_COUNT; ++i)
+            markTableDirty(i);
+    } else {
+        markTableDirty(table);
+    }
+#endif
+    seatingPassPending = true;
 }
 
-// Iteratively tries to seat groups from both VIP/Normal queues
+// Tables a pass retries: the dirty ones, or every table without
+// INCREMENTAL_SEATING
+static int takePassTables(int tables[TABLE_COUNT]) {
+    int n = 0;
+#if INCREMENTAL_SEATING
+    for (int d = 0; d < dirtyCount; ++d) {
+        tables[n++] = dirtyTables[d];
+        tableDirty[dirtyTables[d]] = false;
+    }
+    dirtyCount = 0;
+#else
+    for (int i = 0; i < TABLE_COUNT; ++i)
+        tables[n++] = i;
+#endif
+    return n;
+}
+
+// Seats waiting groups wherever capacity changed. Bin-packing fills each
+// table once, those with the fewest free seats first since they have the
+// fewest fills; the other policies seat one group at a time until nobody
+// fits. Only the service changes tables, so free seats are read unlocked.
 void tryAssignPendingGroups(RestaurantState* state) {
-    bool assignedSomething;
-
-    do {
-        assignedSomething = false;
-
-        if (tryAssignFromQueue(
-            state,
-            state->vipQueue,
-            true,
-            SEM_QUEUE_USED_VIP,
-            SEM_QUEUE_FREE_VIP,
-            false
-        )) {
-            assignedSomething = true;
-            continue;
+    int tables[TABLE_COUNT];
+    int n = takePassTables(tables);
+
+    if (seatingPolicy.fit == SEAT_FIT_PACK) {
+        for (int a = 1; a < n; ++a) {
+            int table = tables[a];
+            int freeSeats = state->tables[table].capacity - state->tables[table].occupiedSeats;
+            int b = a;
+            while (b > 0 && state->tables[tables[b - 1]].capacity - state->tables[tables[b - 1]].occupiedSeats > freeSeats) {
+                tables[b] = tables[b - 1];
+                --b;
+            }
+            tables[b] = table;
         }
 
-        if (tryAssignFromQueue(
-            state,
-            state->normalQueue,
-            false,
-            SEM_QUEUE_USED_NORMAL,
-            SEM_QUEUE_FREE_NORMAL,
-            true
-        )) {
-            assignedSomething = true;
-        }
+        for (int j = 0; j < n; ++j)
+            seatQueued(state, tables[j]);
+        return;
+    }
 
-    } while (assignedSomething);
+#if INCREMENTAL_SEATING
+    for (int j = 0; j < n; ++j)
+        while (seatQueued(state, tables[j])) {
+        }
+#else
+    while (seatQueued(state, -1)) {
+    }
+#endif
 }
 
+static long long queueExpiryNs = 0; // Earliest expiry among queued groups, 0 = none
+
 void handleQueueGroup(const ClientRequest& req) {
     char logBuffer[256];
     
-    bool queued = queuePush(req.pid, req.vipStatus, req.groupSize, req.groupID);
+    long long expiry = 0;
+    bool queued = queuePush(req.pid, req.vipStatus, req.groupSize, req.groupID, req.mailbox, req.patienceMs, expiry);
     
     if (queued) {
+        if (expiry != 0 && (queueExpiryNs == 0 || expiry < queueExpiryNs))
+            queueExpiryNs = expiry;
+
         snprintf(logBuffer, sizeof(logBuffer),
             "\033[32m[%ld] [SERVICE]: GROUP QUEUED | pid=%d groupID=%d size=%d vip=%d\033[0m",
             time(NULL), req.pid, req.groupID, req.groupSize, req.vipStatus);
@@ -225,7 +299,7 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
                 time(NULL), FIXED_GROUP_COUNT);
             fifoLog(logBuffer);
             
-            tryAssignPendingGroups(state);
+            requestSeatingPass(-1);
         }
     }
 
@@ -244,6 +318,16 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
              time(NULL), req.groupID, state->vipQueue.count, state->normalQueue.count);
         fifoLog(logBuffer);
         handleQueueGroup(req);
+
+#if INCREMENTAL_SEATING
+        // A table that already has room for it is not dirty; point the next
+        // pass at one so the group does not wait for a finish there
+        P(SEM_MUTEX_STATE);
+        int table = seatFindTable(state, req.vipStatus, req.groupSize);
+        V(SEM_MUTEX_STATE);
+        if (table != -1)
+            requestSeatingPass(table);
+#endif
         return;
     }
 
@@ -252,12 +336,11 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
 
 #if STRESS_TEST
     // Custom Stress Test gate logic
-    int beltItems = 0;
-    for(int i=0; i<BELT_SIZE; ++i) if(state->belt[i].dishID != 0) beltItems++;
+    int itemsOnBelt = beltItems(state);
     
     static bool stressTestOpened = false;
     
-    if (beltItems >= 500) stressTestOpened = true;
+    if (itemsOnBelt >= 500) stressTestOpened = true;
     
     if (!stressTestOpened) {
         V(SEM_MUTEX_STATE);
@@ -282,9 +365,10 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
         return;
     }
 
-    int assignedTable = assignTable(state, req.vipStatus, req.groupSize, req.groupID, req.pid);
+    int assignedTable = assignTable(state, req.vipStatus, req.groupSize, req.groupID, req.pid, req.mailbox);
 
     if (assignedTable != -1) {
+        noteSeatWait(state, 0, req.vipStatus);
         snprintf(logBuffer, sizeof(logBuffer),
             "\033[32m[%ld] [SERVICE]: TABLE ASSIGNED | tableID=%d pid=%d groupID=%d size=%d vip=%d\033[0m",
             time(NULL), assignedTable, req.pid, req.groupID, req.groupSize, req.vipStatus);
@@ -300,10 +384,10 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
         else
             V(SEM_QUEUE_FREE_NORMAL);
 
-        queueSendRequest(assigned);
+        groupReplySend(req.mailbox, assigned);
         
         if (admissionGateOpen) {
-             tryAssignPendingGroups(state);
+             requestSeatingPass(assignedTable);
         }
         return;
     } else {
@@ -317,6 +401,22 @@ void handleAssignGroup(RestaurantState* state, const ClientRequest& req) {
     handleQueueGroup(req);
 }
 
+// Counts a group that paid off or left; shuts down once all are done
+static void countGroupDone(int& finishedCount) {
+    finishedCount++;
+    
+    // Check for termination condition trigger
+    if (FIXED_GROUP_COUNT > 0 && finishedCount >= FIXED_GROUP_COUNT) {
+         char logBuffer[128];
+         snprintf(logBuffer, sizeof(logBuffer), 
+            "\033[32m[%ld] [SERVICE]: SERVED ALL GROUPS (%d) - INITIATING SHUTDOWN\033[0m", 
+            time(NULL), finishedCount);
+         fifoLog(logBuffer);
+         
+         kill(getppid(), SIGINT); // Trigger shutdown in Main
+    }
+}
+
 // Processes a group that has finished eating
 void handleGroupFinished(RestaurantState* state, const ClientRequest& req, int& finishedCount) {
     pid_t pid = req.pid;
@@ -332,71 +432,168 @@ void handleGroupFinished(RestaurantState* state, const ClientRequest& req, int&
 #endif
 
     P(SEM_MUTEX_STATE);
-    P(SEM_MUTEX_BELT);
 
-    // Free up table slot
-    for (int i = 0; i < TABLE_COUNT; ++i) {
-        Table& t = state->tables[i];
+    // Seat recorded at assignment; scan only without a registry entry
+    int i = -1, s = -1;
+    if (!groupFindSeat(req.mailbox, req.groupID, i, s) || state->tables[i].slots[s].pid != pid) {
+        i = s = -1;
+        for (int ti = 0; ti < TABLE_COUNT && i == -1; ++ti) {
+            for (int si = 0; si < MAX_TABLE_SLOTS; ++si) {
+                if (state->tables[ti].slots[si].pid != pid) continue;
+                i = ti;
+                s = si;
+                break;
+            }
+        }
+    }
 
-        for (int s = 0; s < MAX_TABLE_SLOTS; ++s) {
-            if (t.slots[s].pid != pid) continue;
+    if (i == -1) {
+        V(SEM_MUTEX_STATE);
+        groupMailboxClose(req.mailbox);
+        return;
+    }
 
-            int groupID = req.groupID;
-            int size = t.slots[s].size;
-            bool vip = t.slots[s].vipStatus;
+    // Free up table slot
+    Table& t = state->tables[i];
+    int groupID = req.groupID;
+    int size = t.slots[s].size;
+    bool vip = t.slots[s].vipStatus;
 
 #if ZOMBIE_TEST == 1
 #else
-            cleanZombieDishes(state, groupID);
+    cleanZombieDishes(state, groupID);
 #endif
 
-            int groupDishes = 0;
-            int groupRevenue = 0;
-            for (int j = 0; j < COLOR_COUNT; ++j) {
-                if (eatenCount[j] > 0) {
-                    groupDishes += eatenCount[j];
-                    groupRevenue += eatenCount[j] * priceForColor(colorFromIndex(j));
-                }
-            }
+    int groupDishes = 0;
+    int groupRevenue = 0;
+    for (int j = 0; j < COLOR_COUNT; ++j) {
+        if (eatenCount[j] > 0) {
+            groupDishes += eatenCount[j];
+            groupRevenue += eatenCount[j] * priceForColor(colorFromIndex(j));
+        }
+    }
 
-            t.slots[s].pid = -1;
-            t.slots[s].size = 0;
-            t.slots[s].vipStatus = false;
+    t.slots[s].pid = -1;
+    t.slots[s].size = 0;
+    t.slots[s].vipStatus = false;
 
-            t.occupiedSeats -= size;
-            state->currentGuestCount -= size;
-            if (vip) state->currentVIPCount--;
+    tickSeatClock(state);
+    t.occupiedSeats -= size;
+    state->currentGuestCount -= size;
+    if (vip) state->currentVIPCount--;
+    seatIndexUpdate(state, i);
+    groupRecordSeat(req.mailbox, -1, -1);
 
-            if (t.occupiedSeats == 0) V(SEM_TABLES);
+    if (t.occupiedSeats == 0) V(SEM_TABLES);
 
-            char logBuffer[256];
-            snprintf(logBuffer, sizeof(logBuffer),
-                "\033[32m[%ld] [SERVICE]: GROUP PAID OFF | groupID=%d pid=%d dishes=%d totalPrice=%d\033[0m",
-                time(NULL), groupID, pid, groupDishes, groupRevenue);
-            fifoLog(logBuffer);
+    char logBuffer[256];
+    snprintf(logBuffer, sizeof(logBuffer),
+        "\033[32m[%ld] [SERVICE]: GROUP PAID OFF | groupID=%d pid=%d dishes=%d totalPrice=%d\033[0m",
+        time(NULL), groupID, pid, groupDishes, groupRevenue);
+    fifoLog(logBuffer);
+
+    V(SEM_MUTEX_STATE);
+    groupMailboxClose(req.mailbox);
 
-            V(SEM_MUTEX_BELT);
-            V(SEM_MUTEX_STATE);
+    countGroupDone(finishedCount);
+    requestSeatingPass(i);
+}
 
-            finishedCount++;
-            
-            // Check for termination condition trigger
-            if (FIXED_GROUP_COUNT > 0 && finishedCount >= FIXED_GROUP_COUNT) {
-                 snprintf(logBuffer, sizeof(logBuffer), 
-                    "\033[32m[%ld] [SERVICE]: SERVED ALL GROUPS (%d) - INITIATING SHUTDOWN\033[0m", 
-                    time(NULL), finishedCount);
-                 fifoLog(logBuffer);
-                 
-                 kill(getppid(), SIGINT); // Trigger shutdown in Main
-            }
+// Rejects every queued group whose patience ran out; they count as done
+static void expireQueuedGroups(RestaurantState* state, int& finishedCount) {
+    struct Lost {
+        pid_t pid;
+        int gid;
+        int size;
+        int mailbox;
+        bool vip;
+        long long waitNs;
+    };
+    static Lost lost[2 * MAX_QUEUE];
+    int n = 0;
+    long long now = monotonicNs();
+    long long nextExpiry = 0;
 
-            tryAssignPendingGroups(state);
-            return;
+    P(SEM_MUTEX_QUEUE);
+    P(SEM_MUTEX_STATE);
+
+    for (int v = 0; v < 2; ++v) {
+        GroupQueue& q = v ? state->vipQueue : state->normalQueue;
+        for (int k = 1; k <= MAX_GROUP_SIZE; ++k) {
+            for (int node = q.head[k]; node != -1;) {
+                int next = q.next[node];
+                long long expiry = q.expireNs[node];
+
+                if (expiry != 0 && expiry <= now) {
+                    lost[n++] = { q.groupPid[node], q.groupID[node], k, q.mailbox[node], v == 1, now - q.queuedNs[node] };
+                    state->groupsLost[v]++;
+                    state->peopleLost[v] += k;
+                    state->lostWaitNs += now - q.queuedNs[node];
+                    queueRemove(q, node);
+                } else if (expiry != 0 && (nextExpiry == 0 || expiry < nextExpiry)) {
+                    nextExpiry = expiry;
+                }
+                node = next;
+            }
         }
     }
+    queueExpiryNs = nextExpiry;
 
-    V(SEM_MUTEX_BELT);
     V(SEM_MUTEX_STATE);
+    V(SEM_MUTEX_QUEUE);
+
+    char logBuffer[256];
+    for (int j = 0; j < n; ++j) {
+        const Lost& g = lost[j];
+        V(g.vip ? SEM_QUEUE_FREE_VIP : SEM_QUEUE_FREE_NORMAL);
+
+        snprintf(logBuffer, sizeof(logBuffer),
+            "\033[32m[%ld] [SERVICE]: GROUP LEFT QUEUE | pid=%d groupID=%d size=%d vip=%d waitedMs=%lld\033[0m",
+            time(NULL), g.pid, g.gid, g.size, g.vip, g.waitNs / 1000000);
+        fifoLog(logBuffer);
+
+        ServiceRequest reject{};
+        reject.mtype = g.pid;
+        reject.type = REQ_GROUP_REJECT;
+        groupReplySend(g.mailbox, reject);
+
+        countGroupDone(finishedCount);
+    }
+}
+
+// Dispatches one client request to its handler
+static void handleClientRequest(RestaurantState* state, const ClientRequest& req, int& finishedGroups) {
+    handledRequests++;
+
+    switch (req.type) {
+    case REQ_ASSIGN_GROUP:
+        handleAssignGroup(state, req);
+        break;
+    case REQ_BARRIER_CHECK:
+        {
+            if (FIXED_GROUP_COUNT > 0 && !admissionGateOpen) {
+                P(SEM_MUTEX_STATE);
+                int created = state->totalGroupsCreated;
+                V(SEM_MUTEX_STATE);
+
+                if (created >= FIXED_GROUP_COUNT) {
+                    admissionGateOpen = true;
+                    char log[128];
+                    snprintf(log, sizeof(log), 
+                        "\033[32m[%ld] [SERVICE]: ALL %d GROUPS CREATED - OPENING ADMISSION GATES (SIGNAL)\033[0m",
+                        time(NULL), FIXED_GROUP_COUNT);
+                    fifoLog(log);
+                    requestSeatingPass(-1);
+                }
+            }
+        }
+        break;
+    case REQ_GROUP_FINISHED:
+        handleGroupFinished(state, req, finishedGroups);
+        break;
+    default:
+        break;
+    }
 }
 
 // Main Service Process Loop
@@ -411,39 +608,38 @@ void startService() {
     int finishedGroups = 0;
 
     while (!terminate_flag && !evacuate_flag) {
+        // Block for the first request (until the next queued group gives
+        // up, if any), then drain what is already waiting
         ClientRequest req{};
-        queueRecvRequest(req);
-
-        switch (req.type) {
-        case REQ_ASSIGN_GROUP:
-            handleAssignGroup(state, req);
-            break;
-        case REQ_BARRIER_CHECK:
-            {
-                if (FIXED_GROUP_COUNT > 0 && !admissionGateOpen) {
-                    P(SEM_MUTEX_STATE);
-                    int created = state->totalGroupsCreated;
-                    V(SEM_MUTEX_STATE);
-
-                    if (created >= FIXED_GROUP_COUNT) {
-                        admissionGateOpen = true;
-                        char log[128];
-                        snprintf(log, sizeof(log), 
-                            "\033[32m[%ld] [SERVICE]: ALL %d GROUPS CREATED - OPENING ADMISSION GATES (SIGNAL)\033[0m",
-                            time(NULL), FIXED_GROUP_COUNT);
-                        fifoLog(log);
-                        tryAssignPendingGroups(state);
-                    }
-                }
-            }
-            break;
-        case REQ_GROUP_FINISHED:
-            handleGroupFinished(state, req, finishedGroups);
-            break;
-        default:
-            break;
+        int n = 0;
+        if (queueExpiryNs == 0) {
+            queueRecvRequest(req);
+            handleClientRequest(state, req, finishedGroups);
+            n = 1;
+        } else if (queueRecvRequestUntil(req, queueExpiryNs)) {
+            handleClientRequest(state, req, finishedGroups);
+            n = 1;
+        }
+
+        for (; n < SERVICE_BATCH && queueTryRecvRequest(req); ++n)
+            handleClientRequest(state, req, finishedGroups);
+
+        if (queueExpiryNs != 0 && monotonicNs() >= queueExpiryNs)
+            expireQueuedGroups(state, finishedGroups);
+
+        // One seating pass over all capacity freed by the batch
+        if (seatingPassPending) {
+            seatingPassPending = false;
+            seatingPasses++;
+            tryAssignPendingGroups(state);
         }
     }
 
+    char logBuffer[128];
+    snprintf(logBuffer, sizeof(logBuffer),
+        "\033[32m[%ld] [SERVICE]: REQUESTS HANDLED | requests=%d seatingPasses=%d queueSeatChecks=%d\033[0m",
+        time(NULL), handledRequests, seatingPasses, queueSeatChecks);
+    fifoLog(logBuffer);
+
     fifoCloseWrite();
 }